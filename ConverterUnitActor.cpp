@@ -1,20 +1,28 @@
 
 
 #include "ConverterUnitActor.h"
+#include "MineConversionSolver.h"
 #include "MineshaftGameInstance.h"
 
 
+AConverterUnitActor::AConverterUnitActor()
+{
+	// Converter banks are amounts per conversion, not a stock to draw down
+	DepleteBanks = false;
+}
+
 void AConverterUnitActor::Setup(const FUnitTemplate& unitTemplate) 
 {
+	SeedRandom();
+
 	// Setup rows, X to Y, establish conversion types
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	USessionManager* sm = gi->SessionManager;
-	USessionRules* rules = sm->GetRules();
+	USessionRules* rules = GetContext().Rules;
 
 	// Override EditAnywhere values
 	Columns = 2;
 	
 	// Initialize cell properties
+	CellStore.Init(MaxUnlockRows, Columns);
 	for(int32 rowIndex = 0; rowIndex < MaxUnlockRows; ++rowIndex)
 	{
 		FMineRow minerow;
@@ -27,31 +35,27 @@ void AConverterUnitActor::Setup(const FUnitTemplate& unitTemplate)
 
 		// Two cells per row, cell_0 is the input, cell_1 is the output
 		// Input cell
-		UMineshaftCell* input = NewObject<UMineshaftCell>(this);
-		input->Row = rowIndex;
-		input->Col = 0;
-		minerow.Cells.Add(input);
-		input->Currency = ECurrency::Iron;
-		input->Bank = YieldBase * (1 + (upgradeIndex * rules->UpgradeBaseMultiplier));
+		int32 input = CellStore.Index(rowIndex, 0);
+		CellStore.Currency[input] = ECurrency::Iron;
+		CellStore.Bank[input] = YieldBase * (1 + (upgradeIndex * rules->UpgradeBaseMultiplier));
 		
 		// Output cell
-		UMineshaftCell* output = NewObject<UMineshaftCell>(this);
-		output->Row = rowIndex;
-		output->Col = 1;
-		minerow.Cells.Add(output);
-		output->Bank = input->Bank * YieldMultiplierPadding;
+		int32 output = CellStore.Index(rowIndex, 1);
+		CellStore.Bank[output] = CellStore.Bank[input] * YieldMultiplierPadding;
 		
-		float currencyRNG = FMath::FRand();
+		float currencyRNG = Random.FRand();
 		if(currencyRNG < 0.33f)
-			output->Currency = ECurrency::Stone;
+			CellStore.Currency[output] = ECurrency::Stone;
 		else if(currencyRNG < 0.67f)
-			output->Currency = ECurrency::Copper;
+			CellStore.Currency[output] = ECurrency::Copper;
 		else 
-			output->Currency = ECurrency::Gold;
+			CellStore.Currency[output] = ECurrency::Gold;
 		
 		Rows.Add(minerow);
 	}
 
+	BindCellViews();
+
 	// Unlock initial row, calculates our Yield
 	int32 rowUnlocks = InitialRowUnlocks;
 	for(int32 n = 0; n < rowUnlocks && n < MaxUnlockRows; ++n)
@@ -64,44 +68,79 @@ void AConverterUnitActor::Setup(const FUnitTemplate& unitTemplate)
 	AGridUnitActor::Setup(unitTemplate);
 }
 
-void AConverterUnitActor::GetTotalYieldByRef(TMap<ECurrency, float>& totals)
+// Standalone ratios against the wallet. The batched tick uses FMineConversionSolver across every converter instead.
+void AConverterUnitActor::GetTotalYieldVectorByRef(FCurrencyVector& totals)
 {
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	USessionManager* sm = gi->SessionManager;
-	
-	for(auto& row : Rows)
+	USessionManager* sm = GetContext().SessionManager;
+
+	// Input. Don't spend past currency that you don't have
+	FCurrencyVector demand;
+	AddInputDemand(demand);
+	FCurrencyVector wallet = FCurrencyVector::FromMap(sm->Wallet.Amounts);
+
+	GetTotalYieldAtRatios(totals, FMineConversionSolver::MakeRatios(demand, wallet));
+}
+
+void AConverterUnitActor::AddInputDemand(FCurrencyVector& demand) const
+{
+	check(CellStore.Columns == 2);
+
+	for(int32 rowIndex = 0; rowIndex < Rows.Num(); ++rowIndex)
 	{
-		check(row.Cells.Num() == 2)
+		int32 input = CellStore.Index(rowIndex, 0);
+		if(CellStore.IsProducer(CellStore.Index(rowIndex, 1)) && CellStore.Bank[input] > 0.f)
+			demand.Add(CellStore.Currency[input], CellStore.Bank[input]);
+	}
+}
 
-		UMineshaftCell* input = row.Cells[0];
-		UMineshaftCell* output = row.Cells[1]; 
-		if(output->Producer)
+// Buffs and tech scale the outputs only. The input draw stays at exactly demand * ratio, which is
+// what the solver shared out of the wallet.
+void AConverterUnitActor::GetTotalYieldAtRatios(FCurrencyVector& totals, const FCurrencyVector& ratios)
+{
+	check(CellStore.Columns == 2);
+
+	FCurrencyVector inputs;
+	FCurrencyVector outputs;
+	for(int32 rowIndex = 0; rowIndex < Rows.Num(); ++rowIndex)
+	{
+		int32 input = CellStore.Index(rowIndex, 0);
+		int32 output = CellStore.Index(rowIndex, 1); 
+		if(CellStore.IsProducer(output) && CellStore.Bank[input] > 0.f)
 		{
-			// Input. Don't spend past currency that you don't have
-			float availableInputAmount = sm->GetCurrency(input->Currency);
-			float inputToConvert = input->Bank;
-			float conversionRatio = 1.0f;
-			
-			if(availableInputAmount < inputToConvert)
-			{
-				conversionRatio = availableInputAmount / inputToConvert;
-				inputToConvert = availableInputAmount;
-			}
-
-			if(!totals.Contains(input->Currency))
-				totals.Add(input->Currency, 0.f);
-
-			totals[input->Currency] -= inputToConvert;
-			
-			// Output
-			if(!totals.Contains(output->Currency))
-				totals.Add(output->Currency, 0.f);
-
-			totals[output->Currency] += output->Bank * conversionRatio;
+			float conversionRatio = ratios.Get(CellStore.Currency[input]);
+			inputs.Add(CellStore.Currency[input], -CellStore.Bank[input] * conversionRatio);
+			outputs.Add(CellStore.Currency[output], CellStore.Bank[output] * conversionRatio);
 		}
 	}
 	
-	Super::GetTotalYieldByRef(totals);
+	Super::GetTotalYieldVectorByRef(outputs);
+
+	totals += outputs;
+	totals += inputs;
+}
+
+FCurrencyVector AConverterUnitActor::FastForward(int32 ticks, const FCurrencyVector& wallet, const FCurrencyVector& incomePerTick)
+{
+	FCurrencyVector demand;
+	AddInputDemand(demand);
+
+	FCurrencyVector delta;
+	FMineConversionSolver::ForEachSpan(ticks, demand, wallet, incomePerTick, [&](const FCurrencyVector& ratios, int32 spanTicks)
+	{
+		FCurrencyVector span;
+		GetTotalYieldAtRatios(span, ratios);
+		span.Scale(static_cast<float>(spanTicks));
+		delta += span;
+	});
+	return delta;
+}
+
+// Standalone, nothing else feeds the wallet while this runs
+FCurrencyVector AConverterUnitActor::FastForward(int32 ticks)
+{
+	FCurrencyVector wallet = FCurrencyVector::FromMap(GetContext().SessionManager->Wallet.Amounts);
+
+	return FastForward(ticks, wallet, FCurrencyVector());
 }
 
 // Only flag the output cell as our producer. That's enough state to know this row is active
@@ -109,14 +148,12 @@ void AConverterUnitActor::ToggleRowAsProducer(int32 rowIndex)
 {
 	check(rowIndex >= 0 && rowIndex < Rows.Num());
 
-	UMineshaftCell* cell = Rows[rowIndex].Cells[1];
-	cell->Producer = !cell->Producer;
+	int32 cell = CellStore.Index(rowIndex, 1);
+	CellStore.SetFlag(cell, EMineCellFlags::Producer, !CellStore.IsProducer(cell));
 	CalculateYield();
 }
 
 bool AConverterUnitActor::IsRowProducing(int32 rowIndex)
 {
-	auto& row = Rows[rowIndex];
-	UMineshaftCell* cell = row.Cells[1];
-	return row.Unlocked && cell->Producer;
+	return Rows[rowIndex].Unlocked && CellStore.IsProducer(CellStore.Index(rowIndex, 1));
 }
@@ -11,8 +11,21 @@ class MINESHAFT3_API AConverterUnitActor : public AMineGridUnit
 	GENERATED_BODY()
 
 public:
+	AConverterUnitActor();
+
 	virtual void Setup(const FUnitTemplate& unitTemplate) override;
-	virtual void GetTotalYieldByRef(TMap<ECurrency, float>& totals) override;
+	virtual void GetTotalYieldVectorByRef(FCurrencyVector& totals) override;
+	virtual bool IsYieldCacheable() const override { return false; }
+
+	// Input wanted per tick by producing rows, added per input currency
+	void AddInputDemand(FCurrencyVector& demand) const;
+
+	// One tick of yield with each input currency filled to ratios[currency], 0..1
+	void GetTotalYieldAtRatios(FCurrencyVector& totals, const FCurrencyVector& ratios);
+
+	// Closed form over N ticks given the wallet at the first tick and a constant income per tick from other units
+	FCurrencyVector FastForward(int32 ticks, const FCurrencyVector& wallet, const FCurrencyVector& incomePerTick);
+	virtual FCurrencyVector FastForward(int32 ticks) override;
 
 	UFUNCTION(BlueprintCallable) 
 	void ToggleRowAsProducer(int32 rowIndex);
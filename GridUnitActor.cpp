@@ -6,17 +6,31 @@
 
 void AGridUnitActor::Init(const FUnitTemplate& unitTemplate)
 {
+	BindContext();
+
 	UnitKey = unitTemplate.UnitKey;
 	check(!UnitKey.IsNone());
 	BuffKey = unitTemplate.BuffKey;
 	AttackPatterns = unitTemplate.AttackPatterns;
+	AttackMaskOrigin = FIntPoint(INDEX_NONE, INDEX_NONE);
 	AttackPatternsToUse = unitTemplate.AttackPatternsToUse;
 	BuffPatterns = unitTemplate.BuffPattern;
 	RefreshBuffCoords();
 
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	USessionManager* sm = gi->SessionManager;
-	UnitExplosionDelay = sm->GetRules()->ExplosionDelay;
+	// Live streams keep going. Restored units continue from the saved position, older saves from their seed.
+	if(RandomSeed == 0 || Random.GetInitialSeed() != RandomSeed)
+	{
+		if(RandomSeed != 0 && RandomState != 0)
+			Random.Initialize(RandomState);
+		else
+			SeedRandom();
+	}
+	StoreRandomState();
+
+	UnitExplosionDelay = Context.Rules->ExplosionDelay;
+	Context.GameInstance->GetYieldScheduler().Register(this);
+	UpdateBuffInfluence();
+	SyncBuffs();
 	
 	SetupCompleteBP();
 }
@@ -30,10 +44,40 @@ void AGridUnitActor::Setup(const FUnitTemplate& unitTemplate)
 	FirstSetupCompleteBP();
 };
 
+void AGridUnitActor::BindContext()
+{
+	Context.GameInstance = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
+	Context.SessionManager = Context.GameInstance->SessionManager;
+	Context.Rules = Context.SessionManager->GetRules();
+}
+
+// Units without a seed pick one. Set RandomSeed before Setup for reproducible generation.
+void AGridUnitActor::SeedRandom()
+{
+	// FMath::Rand is rand(), only 15 bits on some platforms. Take all 32 from a fresh guid, 0 is reserved.
+	while(RandomSeed == 0)
+		RandomSeed = static_cast<int32>(GetTypeHash(FGuid::NewGuid()));
+
+	Random.Initialize(RandomSeed);
+	StoreRandomState();
+}
+
+void AGridUnitActor::EndPlay(const EEndPlayReason::Type reason)
+{
+	if(UMineshaftGameInstance* gi = Context.GameInstance)
+	{
+		gi->GetYieldScheduler().Unregister(this);
+		gi->ClearAttackIntent(this);
+		if(gi->SessionManager)
+			RemoveBuffInfluence();
+	}
+
+	Super::EndPlay(reason);
+}
+
 void AGridUnitActor::PostCreate()
 {
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	USessionManager* sm = gi->SessionManager;
+	USessionManager* sm = GetContext().SessionManager;
 
 	// Alert the units this dude is buffing
 	for(auto& coord : BuffCoords)
@@ -52,82 +96,161 @@ void AGridUnitActor::Refresh()
 
 void AGridUnitActor::DoYield()
 {
-	YieldTickBP();
+	FCurrencyVector total;
+	SumYieldAmount(total);
+	AddToWallet(GetContext().SessionManager, total);
+
+	OnYieldTick();
 };
 
+void AGridUnitActor::OnYieldTick()
+{
+	YieldTickBP();
+}
+
 // Unit has been interacted with on the grid (clicked)
 void AGridUnitActor::Activate()
 {
 	if(!CanBeActivated) return;
 
 	OwningGridCell->EndHighlight();
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	gi->SessionManager->SetViewState(EViewState::UnitInteractable);
+	GetContext().SessionManager->SetViewState(EViewState::UnitInteractable);
 	ActivateBP();
 };
 
 // Unit has been exited. Returning to the wider macro view.
 void AGridUnitActor::Deactivate()
 {
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	USessionManager* sm = gi->SessionManager;
-	sm->SetViewState(EViewState::MacroInteractable);
+	GetContext().SessionManager->SetViewState(EViewState::MacroInteractable);
 }
 
 void AGridUnitActor::Clear(int32 delayCount)
 {
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	USessionManager* sm = gi->SessionManager;
+	UMineshaftGameInstance* gi = GetContext().GameInstance;
+	USessionManager* sm = Context.SessionManager;
 
 	if(sm && sm->IsActive())
-	{
-		TMap<ECurrency, float> refund = sm->GetUnitRefund(UnitKey);
-		sm->AddToWallet(refund);
-	}
+		AddToWallet(sm, FCurrencyVector::FromMap(sm->GetUnitRefund(UnitKey)));
+
+	if(sm)
+		RemoveBuffInfluence();
+	gi->ClearAttackIntent(this);
 
 	ClearBP(UnitExplosionDelay * delayCount);
 }
 
+// One AddToWallet per payout so the session's wallet bookkeeping and broadcast run once
+void AGridUnitActor::AddToWallet(USessionManager* sm, const FCurrencyVector& amounts)
+{
+	if(amounts.IsEmpty()) return;
+
+	sm->AddToWallet(amounts.ToMap());
+}
+
+// Only needed when CurrentAttacks or our cell changes. Cells are pushed by the overlay on the next tick.
 void AGridUnitActor::RefreshIntent()
 {
-	if(IsAttackSet())
-	{
-		UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-		USessionManager* sm = gi->SessionManager;
+	UMineshaftGameInstance* gi = GetContext().GameInstance;
+	USessionManager* sm = Context.SessionManager;
 
-		if(!sm) return;
+	if(!sm) return;
 
-		TArray<FCoordinates> coords;
-		for(auto& atk : CurrentAttacks)
-			sm->GetPatternCoordinates(OwningGridCell->Row, OwningGridCell->Col, coords, atk);	
-		
-		for(auto& coord : coords)
-		{
-			AGridCellActor* cell = sm->GetGridCell(coord.Row, coord.Col);
-			cell->AddIntent(EUnitIntent::Attack);	
-		}
+	if(!IsAttackSet())
+	{
+		gi->ClearAttackIntent(this);
+		return;
 	}
+
+	PatternScratch.Reset();
+	for(int32 n = 0; n < CurrentAttacks.Num(); ++n)
+		AppendAttackCoords(sm, n, PatternScratch);
+	gi->SetAttackIntent(this, PatternScratch);
 }
 
 void AGridUnitActor::RefreshBuffCoords()
 {
 	// cache any potential coords up front
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	USessionManager* sm = gi->SessionManager;
-	BuffCoords.Empty();
-	TArray<FCoordinates> coords;
-	sm->GetPatternCoordinates(OwningGridCell->Row, OwningGridCell->Col, coords, BuffPatterns);
-	BuffCoords = TSet<FCoordinates>(coords);
+	UMineshaftGameInstance* gi = GetContext().GameInstance;
+	USessionManager* sm = Context.SessionManager;
+	BuffCoords.Reset();
+	gi->GetPatternTable().Get(sm, OwningGridCell, BuffPatterns, BuffCoords);
+}
+
+void AGridUnitActor::UpdateBuffInfluence()
+{
+	if(!AppliesBuffs() || BuffKey.IsNone()) return;
+
+	const FGridUnitContext& ctx = GetContext();
+	TArray<FCoordinates> touched;
+	ctx.GameInstance->GetBuffInfluence().Add(this, BuffKey, BuffCoords, touched);
+	SyncBuffsAt(ctx.SessionManager, touched);
+}
+
+void AGridUnitActor::RemoveBuffInfluence()
+{
+	const FGridUnitContext& ctx = GetContext();
+	TArray<FCoordinates> touched;
+	ctx.GameInstance->GetBuffInfluence().Remove(this, touched);
+	SyncBuffsAt(ctx.SessionManager, touched);
+}
+
+// Only recompiles when the cell's buffs actually changed
+void AGridUnitActor::SyncBuffs()
+{
+	if(!OwningGridCell) return;
+
+	TArray<FName, TInlineAllocator<8>> buffs;
+	GetContext().GameInstance->GetBuffInfluence().GetBuffs(OwningGridCell->Row, OwningGridCell->Col, buffs);
+
+	bool unchanged = buffs.Num() == Buffs.Num();
+	for(int32 idx = 0; unchanged && idx < buffs.Num(); ++idx)
+		unchanged = buffs[idx] == Buffs[idx];
+
+	if(unchanged) return;
+
+	Buffs.Reset();
+	Buffs.Append(buffs.GetData(), buffs.Num());
+	bBuffsDirty = false;
+	CompileBuffs();
+}
+
+void AGridUnitActor::SyncBuffsAt(USessionManager* sm, TArrayView<const FCoordinates> coords)
+{
+	for(const FCoordinates& coord : coords)
+	{
+		AGridCellActor* cell = sm->GetGridCell(coord.Row, coord.Col);
+		if(cell && cell->UnitActor)
+			cell->UnitActor->SyncBuffs();
+	}
 }
 
 void AGridUnitActor::ClearBuffs()
 {
 	Buffs.Empty();
+	MarkBuffsDirty();
 }
 
 void AGridUnitActor::AddBuff(const FName& key)
 {
 	Buffs.Add(key);
+	MarkBuffsDirty();
+}
+
+// A whole clear and apply pass compiles once, on the next tick or the next yield read
+void AGridUnitActor::MarkBuffsDirty()
+{
+	if(bBuffsDirty) return;
+
+	bBuffsDirty = true;
+	GetWorldTimerManager().SetTimerForNextTick(this, &AGridUnitActor::FlushBuffs);
+}
+
+void AGridUnitActor::FlushBuffs()
+{
+	if(!bBuffsDirty) return;
+
+	bBuffsDirty = false;
+	CompileBuffs();
 }
 
 bool AGridUnitActor::IsAttackSet()
@@ -137,7 +260,9 @@ bool AGridUnitActor::IsAttackSet()
 
 void AGridUnitActor::ClearAttack()
 {
-	CurrentAttacks.Empty();
+	CurrentAttacks.Reset();
+
+	GetContext().GameInstance->ClearAttackIntent(this);
 	ClearAttackBP();
 }
 
@@ -148,40 +273,57 @@ void AGridUnitActor::SetAttack()
 	
 	ClearAttack();
 
-	// Get all attack pattern indices
-	TArray<int32> attackIdices;
-	for(int32 idx = 0; idx < AttackPatterns.Num(); ++idx)
-		attackIdices.Add(idx);
+	// Partial Fisher-Yates, stop drawing once we have enough valid patterns
+	TArray<int32, TInlineAllocator<32>> order;
+	order.SetNumUninitialized(AttackPatterns.Num());
+	for(int32 idx = 0; idx < order.Num(); ++idx)
+		order[idx] = idx;
 
-	// shuffle
-	for(int32 idx = 0; idx < attackIdices.Num(); ++idx)
+	uint64 validMask = GetAttackDirectionMask();
+	for(int32 n = 0; n < order.Num() && CurrentAttacks.Num() < AttackPatternsToUse; ++n)
 	{
-		int32 randIdx = attackIdices[FMath::Rand() % attackIdices.Num()];
-		int32 temp = attackIdices[idx];
-		attackIdices[idx] = attackIdices[randIdx];
-		attackIdices[randIdx] = temp;
-	}
-
-	// set attack pattern when we find a valid one
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	int32 row = OwningGridCell->Row;
-	int32 col = OwningGridCell->Col;
-	for(int32 n = 0; n < attackIdices.Num() && CurrentAttacks.Num() < AttackPatternsToUse; ++n)
-	{
-		int32 idx = attackIdices[n];
-		auto& pattern = AttackPatterns[idx];
-		int32 dr = row + pattern.DirectionRow;
-		int32 dc = col + pattern.DirectionCol;
+		Swap(order[n], order[n + Random.RandHelper(order.Num() - n)]);
 
 		// If this is a blank cell, get out of here
-		if(gi->Grid->GetCell(dr, dc) == nullptr) continue;
+		int32 idx = order[n];
+		if(!IsAttackDirectionValid(idx, validMask)) continue;
 
 		CurrentAttacks.Add(AttackPatterns[idx]);
 	}
+	StoreRandomState();
 	
+	RefreshIntent();
 	Refresh();
 }
 
+// Bit per attack pattern whose direction lands on a grid cell, cached until we change cell
+uint64 AGridUnitActor::GetAttackDirectionMask()
+{
+	FIntPoint origin(OwningGridCell->Col, OwningGridCell->Row);
+	if(origin == AttackMaskOrigin)
+		return AttackDirectionMask;
+
+	AttackDirectionMask = 0;
+	for(int32 idx = 0; idx < AttackPatterns.Num() && idx < 64; ++idx)
+	{
+		if(ProbeAttackDirection(idx))
+			AttackDirectionMask |= 1ull << idx;
+	}
+	AttackMaskOrigin = origin;
+	return AttackDirectionMask;
+}
+
+bool AGridUnitActor::IsAttackDirectionValid(int32 idx, uint64 validMask)
+{
+	return idx < 64 ? (validMask & (1ull << idx)) != 0 : ProbeAttackDirection(idx);
+}
+
+bool AGridUnitActor::ProbeAttackDirection(int32 idx)
+{
+	const FBuffPattern& pattern = AttackPatterns[idx];
+	return GetContext().GameInstance->Grid->GetCell(OwningGridCell->Row + pattern.DirectionRow, OwningGridCell->Col + pattern.DirectionCol) != nullptr;
+}
+
 void AGridUnitActor::Attack()
 {
 	if(CurrentAttacks.Num() == 0)
@@ -192,20 +334,53 @@ void AGridUnitActor::Attack()
 		return;
 	}
 
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	USessionManager* sm = gi->SessionManager;
-	TArray<FCoordinates> coords;
-	for(auto& atk : CurrentAttacks)
-		sm->GetPatternCoordinates(OwningGridCell->Row, OwningGridCell->Col, coords, atk);
-
-	AttackBP(coords);
+	USessionManager* sm = GetContext().SessionManager;
+	PatternScratch.Reset();
+	for(int32 n = 0; n < CurrentAttacks.Num(); ++n)
+		AppendAttackCoords(sm, n, PatternScratch);
+	AttackBP(PatternScratch);
 	ClearAttack();
 }
 
+void AGridUnitActor::AppendAttackCoords(USessionManager* sm, int32 n, TArray<FCoordinates>& coords)
+{
+	// The pattern itself is the table key, restored attacks hit the same entries as fresh ones
+	GetContext().GameInstance->GetPatternTable().Get(sm, OwningGridCell, MakeArrayView(&CurrentAttacks[n], 1), coords);
+}
+
 void AGridUnitActor::MoveTo(int32 row, int32 col)
 {
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	USessionManager* sm = gi->SessionManager;
-	if(sm->MoveUnitTo(OwningGridCell->Row, OwningGridCell->Col, row, col))
+	USessionManager* sm = GetContext().SessionManager;
+	FCoordinates from;
+	from.Row = OwningGridCell->Row;
+	from.Col = OwningGridCell->Col;
+	if(sm->MoveUnitTo(from.Row, from.Col, row, col))
+	{
+		// Only the old and new footprints change, plus whatever now sits where we were
 		RefreshBuffCoords();
+		UpdateBuffInfluence();
+		SyncBuffs();
+
+		// A swap moved that unit too, its own footprint has to follow it
+		AGridCellActor* fromCell = sm->GetGridCell(from.Row, from.Col);
+		AGridUnitActor* swapped = fromCell ? fromCell->UnitActor : nullptr;
+		if(swapped && swapped != this)
+		{
+			swapped->RefreshBuffCoords();
+			swapped->UpdateBuffInfluence();
+		}
+		SyncBuffsAt(sm, MakeArrayView(&from, 1));
+
+		// The overlay clears the old footprint's cells and marks the new ones on the next flush
+		if(IsAttackSet())
+		{
+			RefreshIntent();
+			SetAttackBP();
+		}
+		if(swapped && swapped != this && swapped->IsAttackSet())
+		{
+			swapped->RefreshIntent();
+			swapped->SetAttackBP();
+		}
+	}
 }
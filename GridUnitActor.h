@@ -4,12 +4,16 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 
+#include "MineCurrency.h"
 #include "MineEnums.h"
 #include "UnitTemplateDataTable.h"
 
 #include "GridUnitActor.generated.h"
 
 class AGridCellActor;
+class UMineshaftGameInstance;
+class USessionManager;
+class USessionRules;
 struct FUnitTemplate;
 
 typedef void(AGridUnitActor::*GridUnitActorPtr)();
@@ -23,6 +27,23 @@ enum class EUnitState : uint8
 };
 
 
+// Session handles for unit logic, bound once instead of resolving the game instance on every call
+USTRUCT()
+struct FGridUnitContext
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Transient) 
+	UMineshaftGameInstance* GameInstance = nullptr;
+
+	UPROPERTY(Transient) 
+	USessionManager* SessionManager = nullptr;
+
+	UPROPERTY(Transient) 
+	USessionRules* Rules = nullptr;
+};
+
+
 UCLASS()
 class MINESHAFT3_API AGridUnitActor : public AActor
 {
@@ -33,6 +54,17 @@ public:
 	void Init(const FUnitTemplate& unitTemplate);
 	virtual void Prepare(const FUnitTemplate& unitTemplate) {};
 	virtual void Setup(const FUnitTemplate& unitTemplate);
+	void SeedRandom();
+	void StoreRandomState() { RandomState = Random.GetCurrentSeed(); }
+
+	// Init binds for setup and restore. Mines use the context during generation, before Init, so this binds lazily too.
+	void BindContext();
+	const FGridUnitContext& GetContext()
+	{
+		if(!Context.GameInstance)
+			BindContext();
+		return Context;
+	}
 
 	UFUNCTION(BlueprintImplementableEvent) 
 	void FirstSetupCompleteBP();
@@ -40,10 +72,16 @@ public:
 	UFUNCTION(BlueprintImplementableEvent) 
 	void SetupCompleteBP();
 
+	virtual void EndPlay(const EEndPlayReason::Type reason) override;
 	virtual void PostCreate();
 	virtual void Refresh();
 
-	virtual void DoYield();
+	// Single unit tick. Pays out SumYieldAmount then calls OnYieldTick, exactly like the batched tick.
+	// Final so per-tick logic can't live somewhere FMineYieldScheduler never calls.
+	virtual void DoYield() final;
+
+	// Per-tick logic goes here. Runs after the unit's SumYieldAmount has been paid out, batched or not.
+	virtual void OnYieldTick();
 
 	UFUNCTION(BlueprintImplementableEvent) 
 	void YieldTickBP();
@@ -54,7 +92,10 @@ public:
 	void UpdateStatusBP();
 
 	// Aggregate any potential yield amounts from all Grid Units
-	virtual void SumYieldAmount(TMap<ECurrency, float>& total) {};
+	virtual void SumYieldAmount(FCurrencyVector& total) {};
+
+	// Pay every present lane into the session wallet with a single USessionManager::AddToWallet
+	static void AddToWallet(USessionManager* sm, const FCurrencyVector& amounts);
 	
 	UFUNCTION(BlueprintCallable) 
 	void Activate();
@@ -73,14 +114,27 @@ public:
 	UFUNCTION(BlueprintImplementableEvent) 
 	void ClearBP(float delay);
 
+	// Republish our attack footprint to the session intent overlay
 	virtual void RefreshIntent();
 	virtual void UpdateIntent() {};
 	
 	void RefreshBuffCoords();	
 	void ClearBuffs();
 	void AddBuff(const FName& key);
+
+	// Compile Buffs if ClearBuffs or AddBuff changed them since the last compile
+	void FlushBuffs();
+	virtual void CompileBuffs() {};
 	virtual void ApplyBuffs() {};
 
+	// Session buff influence. Buffing units publish BuffCoords, every unit reads its buffs from its own cell.
+	// Any unit with a BuffKey publishes unless it opts out here.
+	virtual bool AppliesBuffs() const { return true; }
+	void UpdateBuffInfluence();
+	void RemoveBuffInfluence();
+	void SyncBuffs();
+	static void SyncBuffsAt(USessionManager* sm, TArrayView<const FCoordinates> coords);
+
 	UFUNCTION(BlueprintImplementableEvent) 
 	void AddBuffAlertBP();
 
@@ -95,16 +149,23 @@ public:
 	
 	void ClearAttack();
 
+	// Unit visuals only. Cell attack markers are cleared by the session intent overlay.
 	UFUNCTION(BlueprintImplementableEvent) 
 	void ClearAttackBP();
 	
 	void SetAttack();
+	uint64 GetAttackDirectionMask();
+	bool IsAttackDirectionValid(int32 idx, uint64 validMask);
+	bool ProbeAttackDirection(int32 idx);
 
 	UFUNCTION(BlueprintImplementableEvent) 
 	void SetAttackBP(); 
 
 	void Attack();
 
+	// Appends the coordinates of CurrentAttacks[n] from our cell
+	void AppendAttackCoords(USessionManager* sm, int32 n, TArray<FCoordinates>& coords);
+
 	UFUNCTION(BlueprintImplementableEvent) 
 	void AttackBP(const TArray<FCoordinates>& coords);
 	
@@ -144,13 +205,40 @@ public:
 	FName BuffKey; // Buff that this unit can apply
 
 	TArray<FBuffPattern> BuffPatterns;
-	TSet<FCoordinates> BuffCoords;
+
+	// Deduplicated, from the shared pattern table
+	TArray<FCoordinates, TInlineAllocator<16>> BuffCoords;
 
 	TArray<FBuffPattern> AttackPatterns;
 
 	UPROPERTY(SaveGame, BlueprintReadOnly) 
 	TArray<FBuffPattern> CurrentAttacks;
 
+	// Valid attack directions from AttackMaskOrigin, one bit per AttackPatterns index below 64
+	uint64 AttackDirectionMask = 0;
+	FIntPoint AttackMaskOrigin = FIntPoint(INDEX_NONE, INDEX_NONE);
+
+	// Attack coordinates gathered for AttackBP and the intent overlay
+	TArray<FCoordinates> PatternScratch;
+
 	UPROPERTY(BlueprintReadOnly) 
 	int32 AttackPatternsToUse = 1;
+
+	// Seed for all generation and attack selection on this unit. 0 picks a new seed on Setup.
+	UPROPERTY(SaveGame, EditAnywhere, BlueprintReadOnly) 
+	int32 RandomSeed = 0;
+
+	// Random's current seed, so a restored unit continues the stream instead of replaying it. Kept after every draw.
+	UPROPERTY(SaveGame) 
+	int32 RandomState = 0;
+
+	FRandomStream Random;
+
+	UPROPERTY(Transient) 
+	FGridUnitContext Context;
+
+private:
+	void MarkBuffsDirty();
+
+	bool bBuffsDirty = false;
 };
@@ -0,0 +1,410 @@
+#include "MineBalanceCommandlet.h"
+#include "Async/ParallelFor.h"
+#include "MineCellStore.h"
+#include "MineGridUnit.h"
+#include "MineRotationSolver.h"
+#include "MineshaftGameInstance.h"
+#include "MineTraversal.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+namespace
+{
+	// Maze distance from the repo to every producer. Rotations don't change the maze.
+	void MeasurePaths(const FMineCellStore& store, FMineTraversal& traversal, TArray<int32>& distance, FMineBalanceSample& sample)
+	{
+		distance.Init(INDEX_NONE, store.Num());
+		traversal.Begin(store.Num());
+		for(int32 cell = 0; cell < store.Num(); ++cell)
+		{
+			if(store.IsRepo(cell) && traversal.Visit(cell))
+				distance[cell] = 0;
+		}
+
+		int32 total = 0;
+		int32 count = 0;
+		while(traversal.HasNext())
+		{
+			int32 c = traversal.Next();
+			if(store.IsProducer(c))
+			{
+				total += distance[c];
+				count++;
+				sample.MaxPathLength = FMath::Max(sample.MaxPathLength, distance[c]);
+			}
+
+			for(int32 dir = 0; dir < MineDir::Num; ++dir)
+			{
+				if((store.MazeLinks[c] & MineDir::Bit(dir)) == 0) continue;
+
+				int32 neighbor = store.Neighbor(c, dir);
+				if(traversal.Visit(neighbor))
+					distance[neighbor] = distance[c] + 1;
+			}
+		}
+
+		sample.MeanPathLength = count > 0 ? static_cast<float>(total) / count : 0.f;
+	}
+
+	// Base yield per tick of producers linked to the repo within the first activeRows, same linking as AMineGridUnit::LinkCell
+	void MeasureYield(const FMineCellStore& store, TArrayView<const uint8> masks, int32 activeRows, float yieldBase, ECurrency unlockCurrency,
+		FMineTraversal& traversal, float& total, float& unlockYield)
+	{
+		total = 0.f;
+		unlockYield = 0.f;
+
+		traversal.Begin(store.Num());
+		for(int32 cell = 0; cell < store.Num(); ++cell)
+		{
+			if(store.IsRepo(cell) && store.RowOf(cell) < activeRows)
+				traversal.Visit(cell);
+		}
+
+		while(traversal.HasNext())
+		{
+			int32 c = traversal.Next();
+			if(store.IsProducer(c) && store.Bank[c] > 0.f)
+			{
+				float yield = FMath::Min(yieldBase, store.Bank[c]);
+				total += yield;
+				if(store.Currency[c] == unlockCurrency)
+					unlockYield += yield;
+			}
+
+			for(int32 dir = 0; dir < MineDir::Num; ++dir)
+			{
+				if((masks[c] & MineDir::Bit(dir)) == 0) continue;
+
+				int32 neighbor = store.Neighbor(c, dir);
+				if(neighbor != INDEX_NONE && store.RowOf(neighbor) < activeRows && (masks[neighbor] & MineDir::Bit(MineDir::Opposite(dir))))
+					traversal.Visit(neighbor);
+			}
+		}
+	}
+
+	// "Stone:1,Copper:0.5"
+	bool ParseChances(const FString& text, TMap<ECurrency, float>& chances)
+	{
+		TArray<FString> entries;
+		text.ParseIntoArray(entries, TEXT(","));
+
+		chances.Reset();
+		for(const FString& entry : entries)
+		{
+			FString name, weight;
+			if(!entry.Split(TEXT(":"), &name, &weight)) return false;
+
+			int64 value = StaticEnum<ECurrency>()->GetValueByNameString(name);
+			if(value == INDEX_NONE) return false;
+
+			chances.Add(static_cast<ECurrency>(value), FCString::Atof(*weight));
+		}
+		return chances.Num() > 0;
+	}
+}
+
+
+void FMineHistogram::Add(double value)
+{
+	Buckets.FindOrAdd(FMath::FloorToInt64(value / Width))++;
+	Count++;
+	Sum += value;
+	Min = FMath::Min(Min, value);
+	Max = FMath::Max(Max, value);
+}
+
+
+UMineBalanceCommandlet::UMineBalanceCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UMineBalanceCommandlet::Main(const FString& params)
+{
+	if(!ParseParams(params)) return 1;
+
+	FString out = FPaths::ProjectSavedDir() / TEXT("Balance") / TEXT("MineBalance.csv");
+	FParse::Value(*params, TEXT("Out="), out);
+
+	// Batches keep memory flat, only the histograms outlive a batch
+	TArray<FMineGenParams> batch;
+	TArray<FMineGenResult> generated;
+	TArray<FMineBalanceSample> samples;
+	for(int32 first = 0; first < Mines; first += BatchSize)
+	{
+		int32 num = FMath::Min(BatchSize, Mines - first);
+		batch.Reset();
+		for(int32 idx = 0; idx < num; ++idx)
+		{
+			FMineGenParams& p = batch.Add_GetRef(GenParams);
+			p.Random.Initialize(Seed + first + idx);
+		}
+
+		GenerateMines(batch, generated);
+
+		samples.Reset();
+		samples.SetNum(num);
+		ParallelFor(num, [&](int32 idx)
+		{
+			Sample(generated[idx], Seed + first + idx, samples[idx]);
+		});
+
+		// Merged in seed order so the output doesn't depend on scheduling
+		for(const FMineBalanceSample& sample : samples)
+			Accumulate(sample);
+
+		UE_LOG(MineshaftLog, Display, TEXT("[BALANCE] %d / %d mines"), first + num, Mines);
+	}
+
+	WriteResults(out);
+	return 0;
+}
+
+bool UMineBalanceCommandlet::ParseParams(const FString& params)
+{
+	UClass* unitClass = AMineGridUnit::StaticClass();
+	FString unitPath;
+	if(FParse::Value(*params, TEXT("Unit="), unitPath))
+	{
+		unitClass = LoadClass<AMineGridUnit>(nullptr, *unitPath);
+		if(!unitClass)
+		{
+			UE_LOG(MineshaftLog, Error, TEXT("[BALANCE] failed to load unit class %s"), *unitPath);
+			return false;
+		}
+	}
+
+	// Same fields AMineGridUnit::MakeGenParams reads. Tech isn't applied, there is no session.
+	const AMineGridUnit* defaults = unitClass->GetDefaultObject<AMineGridUnit>();
+	GenParams.Columns = defaults->Columns;
+	GenParams.MaxUnlockRows = defaults->MaxUnlockRows;
+	GenParams.UnlockCurrency = defaults->UnlockCurrency;
+	GenParams.UnlockBaseCost = defaults->UnlockBaseCost;
+	GenParams.BankInitialMin = defaults->BankInitialMin;
+	GenParams.BankInitialMax = defaults->BankInitialMax;
+	GenParams.ProducerChances = defaults->ProducerChances;
+	GenParams.RotateTracks = defaults->RotateTracksOnSetup;
+	GenParams.MazeAlgorithm = defaults->MazeAlgorithm;
+	YieldBase = defaults->YieldBase;
+	InitialRowUnlocks = defaults->InitialRowUnlocks;
+
+	FParse::Value(*params, TEXT("Columns="), GenParams.Columns);
+	FParse::Value(*params, TEXT("Rows="), GenParams.MaxUnlockRows);
+	FParse::Value(*params, TEXT("BankMin="), GenParams.BankInitialMin);
+	FParse::Value(*params, TEXT("BankMax="), GenParams.BankInitialMax);
+	FParse::Value(*params, TEXT("UnlockBaseCost="), GenParams.UnlockBaseCost);
+	FParse::Value(*params, TEXT("YieldBase="), YieldBase);
+	FParse::Value(*params, TEXT("Mines="), Mines);
+	FParse::Value(*params, TEXT("Seed="), Seed);
+	FParse::Value(*params, TEXT("Restarts="), Restarts);
+
+	FString maze;
+	if(FParse::Value(*params, TEXT("Maze="), maze))
+	{
+		int64 value = StaticEnum<EMineMazeAlgorithm>()->GetValueByNameString(maze);
+		if(value == INDEX_NONE)
+		{
+			UE_LOG(MineshaftLog, Error, TEXT("[BALANCE] unknown -Maze=%s"), *maze);
+			return false;
+		}
+		GenParams.MazeAlgorithm = static_cast<EMineMazeAlgorithm>(value);
+	}
+
+	// In game the upgrade multiplier comes from the session rules. Set up a standalone session like the benchmark does.
+	FString rulesPath;
+	const TCHAR* multiplierSource = TEXT("default");
+	if(FParse::Value(*params, TEXT("Rules="), rulesPath))
+	{
+		URulesConfig* cfg = LoadObject<URulesConfig>(nullptr, *rulesPath);
+		if(!cfg)
+		{
+			UE_LOG(MineshaftLog, Error, TEXT("[BALANCE] failed to load rules %s"), *rulesPath);
+			return false;
+		}
+
+		UMineshaftGameInstance* gi = NewObject<UMineshaftGameInstance>(GEngine);
+		gi->InitializeStandalone();
+		gi->Setup(cfg);
+		if(!gi->SessionManager || !gi->SessionManager->GetRules())
+		{
+			UE_LOG(MineshaftLog, Error, TEXT("[BALANCE] no session rules from %s"), *rulesPath);
+			return false;
+		}
+
+		GenParams.UpgradeBaseMultiplier = gi->SessionManager->GetRules()->UpgradeBaseMultiplier;
+		multiplierSource = TEXT("rules");
+	}
+
+	if(FParse::Value(*params, TEXT("UpgradeMultiplier="), GenParams.UpgradeBaseMultiplier))
+		multiplierSource = TEXT("-UpgradeMultiplier");
+
+	UE_LOG(MineshaftLog, Display, TEXT("[BALANCE] UpgradeBaseMultiplier %.3f (%s)"), GenParams.UpgradeBaseMultiplier, multiplierSource);
+
+	FString chances;
+	if(FParse::Value(*params, TEXT("Chances="), chances, false) && !ParseChances(chances, GenParams.ProducerChances))
+	{
+		UE_LOG(MineshaftLog, Error, TEXT("[BALANCE] bad -Chances=%s, expected Currency:Weight,..."), *chances);
+		return false;
+	}
+
+	if(GenParams.ProducerChances.Num() == 0)
+	{
+		UE_LOG(MineshaftLog, Warning, TEXT("[BALANCE] unit has no ProducerChances, using Stone:1"));
+		GenParams.ProducerChances.Add(ECurrency::Stone, 1.f);
+	}
+
+	// Generation picks the repo from columns 1..N-1
+	if(GenParams.Columns < 2 || GenParams.MaxUnlockRows < 1 || Mines < 1)
+	{
+		UE_LOG(MineshaftLog, Error, TEXT("[BALANCE] need at least 2 columns, 1 row and 1 mine"));
+		return false;
+	}
+
+	// Yield histograms use YieldBase as their bucket width
+	if(YieldBase <= 0.f)
+	{
+		UE_LOG(MineshaftLog, Error, TEXT("[BALANCE] YieldBase must be above 0, got %f"), YieldBase);
+		return false;
+	}
+
+	InitialRowUnlocks = FMath::Clamp(InitialRowUnlocks, 1, GenParams.MaxUnlockRows);
+	return true;
+}
+
+// Optimal rotations maximize linked producers. Banks start far above YieldBase so that is also the best yield.
+void UMineBalanceCommandlet::Sample(const FMineGenResult& mine, int32 seed, FMineBalanceSample& sample) const
+{
+	const FMineCellStore& store = mine.Store;
+	FMineTraversal traversal;
+	TArray<int32> distance;
+
+	sample.Producers = mine.TotalProducers;
+	MeasurePaths(store, traversal, distance, sample);
+
+	float unlockYield = 0.f;
+	MeasureYield(store, store.WallOrientation, store.NumRows, YieldBase, GenParams.UnlockCurrency, traversal, sample.RandomYield, unlockYield);
+
+	// Solve each unlock stage, the yield before a row pays for it
+	FMineRotationSolveParams solve;
+	solve.Restarts = Restarts;
+	solve.Seed = seed;
+	TArray<uint8> masks;
+	masks.SetNumUninitialized(store.Num());
+	for(int32 rows = InitialRowUnlocks; rows <= store.NumRows; ++rows)
+	{
+		solve.Active.Init(false, store.Num());
+		solve.Active.SetRange(0, rows * store.Columns, true);
+
+		FMineRotationSolution solution;
+		SolveRotations(store, solve, solution);
+		for(int32 cell = 0; cell < store.Num(); ++cell)
+			masks[cell] = MineCellTables::Rotate(store.WallOrientation[cell], solution.TurnsCW[cell]);
+
+		float total = 0.f;
+		MeasureYield(store, masks, rows, YieldBase, GenParams.UnlockCurrency, traversal, total, unlockYield);
+
+		if(rows < store.NumRows)
+		{
+			sample.PaybackTicks.Add(unlockYield > 0.f ? mine.UnlockCosts[rows] / unlockYield : MAX_flt);
+		}
+		else
+		{
+			sample.OptimalYield = total;
+			sample.bProvenOptimal = solution.IsOptimal();
+		}
+	}
+}
+
+void UMineBalanceCommandlet::Accumulate(const FMineBalanceSample& sample)
+{
+	GetHistogram(TEXT("producers"), 1.0).Add(sample.Producers);
+	GetHistogram(TEXT("path_length_mean"), 1.0).Add(sample.MeanPathLength);
+	GetHistogram(TEXT("path_length_max"), 1.0).Add(sample.MaxPathLength);
+	GetHistogram(TEXT("yield_random"), YieldBase).Add(sample.RandomYield);
+	GetHistogram(TEXT("yield_optimal"), YieldBase).Add(sample.OptimalYield);
+	GetHistogram(TEXT("yield_gain"), YieldBase).Add(sample.OptimalYield - sample.RandomYield);
+
+	const double paybackWidth = 10.0;
+	float totalPayback = 0.f;
+	for(int32 idx = 0; idx < sample.PaybackTicks.Num(); ++idx)
+	{
+		FMineHistogram& histogram = GetHistogram(FString::Printf(TEXT("payback_row_%d"), InitialRowUnlocks + idx), paybackWidth);
+		float ticks = sample.PaybackTicks[idx];
+		if(ticks == MAX_flt)
+		{
+			histogram.AddUnbounded();
+			totalPayback = MAX_flt;
+		}
+		else
+		{
+			histogram.Add(ticks);
+			if(totalPayback != MAX_flt)
+				totalPayback += ticks;
+		}
+	}
+
+	if(sample.PaybackTicks.Num() > 0)
+	{
+		FMineHistogram& total = GetHistogram(TEXT("payback_total"), paybackWidth);
+		if(totalPayback == MAX_flt)
+			total.AddUnbounded();
+		else
+			total.Add(totalPayback);
+	}
+
+	if(sample.bProvenOptimal)
+		ProvenOptimal++;
+}
+
+FMineHistogram& UMineBalanceCommandlet::GetHistogram(const FString& metric, double width)
+{
+	for(FMineHistogram& histogram : Histograms)
+	{
+		if(histogram.Metric == metric)
+			return histogram;
+	}
+
+	FMineHistogram* histogram = new FMineHistogram();
+	histogram->Metric = metric;
+	histogram->Width = width;
+	Histograms.Add(histogram);
+	return *histogram;
+}
+
+void UMineBalanceCommandlet::WriteResults(const FString& path) const
+{
+	FString csv = TEXT("metric,bucket_min,bucket_max,count,fraction\n");
+	for(const FMineHistogram& histogram : Histograms)
+	{
+		UE_LOG(MineshaftLog, Display, TEXT("[BALANCE] %s: mean %.2f min %.2f max %.2f unbounded %lld of %lld"),
+			*histogram.Metric, histogram.Mean(), histogram.Min, histogram.Max, histogram.Unbounded, histogram.Count);
+
+		TArray<int64> keys;
+		histogram.Buckets.GetKeys(keys);
+		keys.Sort();
+
+		for(int64 key : keys)
+		{
+			int64 count = histogram.Buckets[key];
+			csv += FString::Printf(TEXT("%s,%.3f,%.3f,%lld,%.6f\n"), *histogram.Metric,
+				key * histogram.Width, (key + 1) * histogram.Width, count, static_cast<double>(count) / histogram.Count);
+		}
+
+		if(histogram.Unbounded > 0)
+		{
+			csv += FString::Printf(TEXT("%s,inf,inf,%lld,%.6f\n"), *histogram.Metric,
+				histogram.Unbounded, static_cast<double>(histogram.Unbounded) / histogram.Count);
+		}
+	}
+
+	UE_LOG(MineshaftLog, Display, TEXT("[BALANCE] solver reached the upper bound on %lld of %d mines"), ProvenOptimal, Mines);
+
+	if(FFileHelper::SaveStringToFile(csv, *path))
+		UE_LOG(MineshaftLog, Display, TEXT("[BALANCE] results written to %s"), *path);
+	else
+		UE_LOG(MineshaftLog, Error, TEXT("[BALANCE] failed to write %s"), *path);
+}
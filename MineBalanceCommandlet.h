@@ -0,0 +1,82 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+
+#include "MineGeneration.h"
+
+#include "MineBalanceCommandlet.generated.h"
+
+
+// Sparse fixed-width histogram. Only counts are kept so millions of samples cost a few buckets.
+struct FMineHistogram
+{
+	void Add(double value);
+	void AddUnbounded() { Count++; Unbounded++; }
+	double Mean() const { return Count > Unbounded ? Sum / (Count - Unbounded) : 0.0; }
+
+	FString Metric;
+	double Width = 1.0;
+	TMap<int64, int64> Buckets;
+	int64 Count = 0;
+	int64 Unbounded = 0;		// samples with no finite value, e.g. payback on a mine that yields nothing
+	double Sum = 0.0;
+	double Min = MAX_dbl;
+	double Max = -MAX_dbl;
+};
+
+// Numbers for one generated mine, filled on a worker thread
+struct FMineBalanceSample
+{
+	int32 Producers = 0;
+	float MeanPathLength = 0.f;
+	int32 MaxPathLength = 0;
+	float RandomYield = 0.f;
+	float OptimalYield = 0.f;
+	bool bProvenOptimal = false;
+
+	// Ticks of unlock currency yield to afford each row past the initial unlocks, MAX_flt if nothing pays toward it
+	TArray<float, TInlineAllocator<8>> PaybackTicks;
+};
+
+
+// Monte Carlo over mine generation parameters. Generates seeded mines through the same GenerateMine pass as
+// AMineGridUnit::Setup and writes distribution histograms as CSV.
+// Defaults come from the unit class, flags override them.
+// Pass -Rules= for the session's UpgradeBaseMultiplier, without it unlock costs use 1.
+// Usage: UnrealEditor-Cmd <project> -run=MineBalance [-Rules=<RulesConfig asset>] [-Unit=<AMineGridUnit class>] [-Mines=100000] [-Seed=1337]
+//   [-Columns=] [-Rows=] [-Chances=Stone:1,Copper:0.5] [-BankMin=] [-BankMax=] [-UnlockBaseCost=] [-UpgradeMultiplier=]
+//   [-YieldBase=] [-Maze=BinaryTree|Wilson|RecursiveBacktracker|GrowingTree] [-Restarts=2] [-Out=<csv>]
+UCLASS()
+class MINESHAFT3_API UMineBalanceCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UMineBalanceCommandlet();
+
+	virtual int32 Main(const FString& params) override;
+
+private:
+	bool ParseParams(const FString& params);
+
+	// Thread safe, reads only the settings
+	void Sample(const FMineGenResult& mine, int32 seed, FMineBalanceSample& sample) const;
+	void Accumulate(const FMineBalanceSample& sample);
+
+	// Histograms are heap allocated so references stay valid while more are added
+	FMineHistogram& GetHistogram(const FString& metric, double width);
+
+	void WriteResults(const FString& path) const;
+
+	FMineGenParams GenParams;
+	float YieldBase = 5.f;
+	int32 InitialRowUnlocks = 1;
+	int32 Mines = 100000;
+	int32 BatchSize = 4096;
+	int32 Restarts = 2;
+	int32 Seed = 1337;
+	int64 ProvenOptimal = 0;
+
+	TIndirectArray<FMineHistogram> Histograms;
+};
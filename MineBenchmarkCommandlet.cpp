@@ -0,0 +1,574 @@
+#include "MineBenchmarkCommandlet.h"
+#include "ConverterUnitActor.h"
+#include "GridCellActor.h"
+#include "MineCellStore.h"
+#include "MineGeneration.h"
+#include "MineGridUnit.h"
+#include "MineMazeGenerators.h"
+#include "MineshaftGameInstance.h"
+#include "MineTraversal.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+// Forwards to the real allocator. Only counts allocations made on a thread inside Measure, so task graph
+// workers and async loading don't land in allocs_per_op.
+class FMallocCounter : public FMalloc
+{
+public:
+	explicit FMallocCounter(FMalloc* inner) : Inner(inner) {}
+
+	virtual void* Malloc(SIZE_T count, uint32 alignment) override
+	{
+		if(bCounting)
+			Allocs++;
+		return Inner->Malloc(count, alignment);
+	}
+
+	virtual void* Realloc(void* ptr, SIZE_T count, uint32 alignment) override
+	{
+		if(bCounting)
+			Allocs++;
+		return Inner->Realloc(ptr, count, alignment);
+	}
+
+	virtual void Free(void* ptr) override { Inner->Free(ptr); }
+	virtual SIZE_T QuantizeSize(SIZE_T count, uint32 alignment) override { return Inner->QuantizeSize(count, alignment); }
+	virtual bool GetAllocationSize(void* ptr, SIZE_T& size) override { return Inner->GetAllocationSize(ptr, size); }
+	virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+	virtual const TCHAR* GetDescriptiveName() override { return TEXT("MineBenchmarkCounter"); }
+
+	// Wraps GMalloc on first use and stays installed for the life of the process. Workers are already
+	// running by the time a commandlet starts, so it is never swapped back out from under them.
+	static void Install()
+	{
+		static FMallocCounter* counter = nullptr;
+		if(counter) return;
+
+		counter = new FMallocCounter(GMalloc);
+		FPlatformAtomics::InterlockedExchangePtr(reinterpret_cast<void**>(&GMalloc), counter);
+	}
+
+	FMalloc* Inner = nullptr;
+
+	// Set by Measure on the measuring thread only
+	static thread_local bool bCounting;
+	static thread_local int64 Allocs;
+};
+
+thread_local bool FMallocCounter::bCounting = false;
+thread_local int64 FMallocCounter::Allocs = 0;
+
+
+namespace
+{
+	// Fully linked binary tree maze, every cell reachable from cell 0
+	void BuildLinkedStore(FMineCellStore& store, int32 rows, int32 columns, int32 seed)
+	{
+		FRandomStream rng(seed);
+		store.Init(rows, columns);
+
+		auto link = [&](int32 cell, int32 dir)
+		{
+			int32 next = store.Neighbor(cell, dir);
+			store.MazeLinks[cell] |= MineDir::Bit(dir);
+			store.MazeLinks[next] |= MineDir::Bit(MineDir::Opposite(dir));
+		};
+
+		for(int32 r = 0; r < rows; ++r)
+		{
+			for(int32 c = 0; c < columns; ++c)
+			{
+				int32 cell = store.Index(r, c);
+				bool canEast = c < columns-1;
+				bool canNorth = r > 0;
+				if(canEast && (!canNorth || rng.FRand() < 0.5f))
+					link(cell, MineDir::East);
+				else if(canNorth)
+					link(cell, MineDir::North);
+			}
+		}
+
+		store.WallOrientation = store.MazeLinks;
+		store.YieldLinks = store.MazeLinks;
+	}
+
+	// The original CalculateYield search: front-pop array and hashed visited set
+	int32 LegacySearch(const FMineCellStore& store, int32 start)
+	{
+		TArray<int32> toVisit = { start };
+		TSet<int32> visited;
+		while(toVisit.Num() > 0)
+		{
+			int32 c = toVisit[0];
+			toVisit.RemoveAt(0);
+
+			if(visited.Contains(c)) continue;
+			visited.Add(c);
+
+			for(int32 dir = 0; dir < MineDir::Num; ++dir)
+			{
+				if((store.YieldLinks[c] & MineDir::Bit(dir)) == 0) continue;
+
+				int32 link = store.Neighbor(c, dir);
+				if(!visited.Contains(link))
+					toVisit.Add(link);
+			}
+		}
+		return visited.Num();
+	}
+
+	int32 TraversalSearch(const FMineCellStore& store, FMineTraversal& traversal, int32 start)
+	{
+		int32 count = 0;
+		traversal.Begin(store.Num());
+		traversal.Visit(start);
+		while(traversal.HasNext())
+		{
+			int32 c = traversal.Next();
+			count++;
+
+			for(int32 dir = 0; dir < MineDir::Num; ++dir)
+			{
+				if(store.YieldLinks[c] & MineDir::Bit(dir))
+					traversal.Visit(store.Neighbor(c, dir));
+			}
+		}
+		return count;
+	}
+
+	double Percentile(const TArray<double>& sorted, double pct)
+	{
+		if(sorted.Num() == 0) return 0.0;
+		int32 idx = FMath::Clamp(FMath::CeilToInt(pct * sorted.Num()) - 1, 0, sorted.Num()-1);
+		return sorted[idx];
+	}
+
+	const ECurrency GBenchCurrencies[] = { ECurrency::Stone, ECurrency::Copper, ECurrency::Iron, ECurrency::Gold };
+}
+
+
+UMineBenchmarkCommandlet::UMineBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UMineBenchmarkCommandlet::Main(const FString& params)
+{
+	FString bench = TEXT("All");
+	FParse::Value(*params, TEXT("Bench="), bench);
+	FParse::Value(*params, TEXT("Seed="), Seed);
+
+	FString out = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / TEXT("MineBenchmark.csv");
+	FParse::Value(*params, TEXT("Out="), out);
+
+	auto run = [&](const TCHAR* name) { return bench == TEXT("All") || bench == name; };
+
+	FMallocCounter::Install();
+
+	if(run(TEXT("Traversal")))
+		BenchTraversal();
+
+	if(run(TEXT("Maze")))
+		BenchMaze();
+
+	// Everything else drives real units and needs a session
+	bool needsSession = run(TEXT("Generation")) || run(TEXT("Rotation")) || run(TEXT("Unlock")) || run(TEXT("Yield"));
+	if(needsSession && SetupSession(params))
+	{
+		if(run(TEXT("Generation")))	BenchGeneration();
+		if(run(TEXT("Rotation")))	BenchRotation();
+		if(run(TEXT("Unlock")))		BenchUnlock();
+		if(run(TEXT("Yield")))		BenchYield();
+	}
+
+	WriteResults(out);
+	return 0;
+}
+
+// Standalone game instance with a dummy world, no viewport or rendering
+bool UMineBenchmarkCommandlet::SetupSession(const FString& params)
+{
+	FString rulesPath;
+	if(!FParse::Value(*params, TEXT("Rules="), rulesPath))
+	{
+		UE_LOG(MineshaftLog, Error, TEXT("[BENCH] -Rules=<RulesConfig asset> is required for unit benchmarks"));
+		return false;
+	}
+
+	URulesConfig* cfg = LoadObject<URulesConfig>(nullptr, *rulesPath);
+	if(!cfg)
+	{
+		UE_LOG(MineshaftLog, Error, TEXT("[BENCH] failed to load rules %s"), *rulesPath);
+		return false;
+	}
+
+	GameInstance = NewObject<UMineshaftGameInstance>(GEngine);
+	GameInstance->InitializeStandalone();
+	GameInstance->Setup(cfg);
+	World = GameInstance->GetWorld();
+	return World && GameInstance->SessionManager;
+}
+
+// Unlocks and converters should never be starved during a benchmark
+void UMineBenchmarkCommandlet::FillWallet()
+{
+	USessionManager* sm = GameInstance->SessionManager;
+	for(ECurrency currency : GBenchCurrencies)
+		sm->UpdateWallet(currency, 1e9f);
+}
+
+template<typename UnitType>
+UnitType* UMineBenchmarkCommandlet::SpawnUnit(int32 columns, int32 rows, int32 seed)
+{
+	AGridCellActor* cell = World->SpawnActor<AGridCellActor>();
+	UnitType* unit = World->SpawnActor<UnitType>();
+	unit->OwningGridCell = cell;
+	unit->RandomSeed = seed;
+	unit->Columns = columns;
+	unit->MaxUnlockRows = rows;
+	unit->ProducerChances.Add(ECurrency::Stone, 1.f);
+	unit->ProducerChances.Add(ECurrency::Copper, 0.5f);
+	return unit;
+}
+
+// The commandlet world never begins play, so Destroy doesn't route EndPlay. Unregister here instead.
+// Takes the cell SpawnUnit made with it so long runs don't pile up actors.
+void UMineBenchmarkCommandlet::DestroyUnit(AGridUnitActor* unit)
+{
+	GameInstance->GetYieldScheduler().Unregister(unit);
+
+	AGridCellActor* cell = unit->OwningGridCell;
+	unit->Destroy();
+	if(cell)
+		cell->Destroy();
+}
+
+void UMineBenchmarkCommandlet::UnlockAll(AMineGridUnit* unit)
+{
+	while(!unit->IsFullyUnlocked() && unit->UnlockMineRow()) {}
+}
+
+FMineBenchResult& UMineBenchmarkCommandlet::AddResult(const FString& scenario, const FString& op)
+{
+	FMineBenchResult* result = new FMineBenchResult();
+	result->Scenario = scenario;
+	result->Op = op;
+	Results.Add(result);
+	return *result;
+}
+
+template<typename FuncType>
+void UMineBenchmarkCommandlet::Measure(FMineBenchResult& result, FuncType&& func)
+{
+	FMallocCounter::Allocs = 0;
+	FMallocCounter::bCounting = true;
+	double start = FPlatformTime::Seconds();
+	func();
+	result.Samples.Add(FPlatformTime::Seconds() - start);
+	FMallocCounter::bCounting = false;
+	result.Allocs += FMallocCounter::Allocs;
+}
+
+void UMineBenchmarkCommandlet::BenchTraversal()
+{
+	struct FGridSize { int32 Columns; int32 Rows; };
+	const FGridSize sizes[] = { {8, 2}, {16, 16}, {32, 32}, {64, 64}, {128, 128}, {256, 256} };
+
+	for(const FGridSize& size : sizes)
+	{
+		FMineCellStore store;
+		BuildLinkedStore(store, size.Rows, size.Columns, Seed);
+		FString scenario = FString::Printf(TEXT("traversal_%dx%d"), size.Columns, size.Rows);
+
+		// Enough runs for stable percentiles without the legacy search taking minutes on the large grids
+		int32 runs = FMath::Clamp(200000 / store.Num(), 5, 1000);
+
+		FMineBenchResult& legacy = AddResult(scenario, TEXT("legacy_bfs"));
+		for(int32 n = 0; n < runs; ++n)
+			Measure(legacy, [&]() { verify(LegacySearch(store, 0) == store.Num()); });
+
+		FMineTraversal traversal;
+		FMineBenchResult& engine = AddResult(scenario, TEXT("traversal_bfs"));
+		for(int32 n = 0; n < runs; ++n)
+			Measure(engine, [&]() { verify(TraversalSearch(store, traversal, 0) == store.Num()); });
+	}
+}
+
+// Carving alone on the packed store, sizes well past anything a unit spawns with
+void UMineBenchmarkCommandlet::BenchMaze()
+{
+	struct FGridSize { int32 Columns; int32 Rows; };
+	const FGridSize sizes[] = { {8, 8}, {64, 64}, {256, 256}, {1024, 1024} };
+	const EMineMazeAlgorithm algorithms[] = { EMineMazeAlgorithm::BinaryTree, EMineMazeAlgorithm::Wilson, EMineMazeAlgorithm::RecursiveBacktracker, EMineMazeAlgorithm::GrowingTree };
+
+	for(const FGridSize& size : sizes)
+	{
+		FString scenario = FString::Printf(TEXT("maze_%dx%d"), size.Columns, size.Rows);
+		int32 runs = FMath::Clamp(2000000 / (size.Columns * size.Rows), 5, 1000);
+
+		for(EMineMazeAlgorithm algorithm : algorithms)
+		{
+			FMineMazeCarveFunc carve = GetMazeCarver(algorithm);
+			FMineBenchResult& result = AddResult(scenario, StaticEnum<EMineMazeAlgorithm>()->GetNameStringByValue(static_cast<int64>(algorithm)));
+
+			FMineCellStore store;
+			for(int32 n = 0; n < runs; ++n)
+			{
+				store.Init(size.Rows, size.Columns);
+				FRandomStream random(Seed + n);
+				Measure(result, [&]() { carve(store, random); });
+			}
+		}
+	}
+}
+
+void UMineBenchmarkCommandlet::BenchGeneration()
+{
+	struct FGridSize { int32 Columns; int32 Rows; };
+	const FGridSize sizes[] = { {8, 2}, {8, 8}, {16, 16}, {32, 32}, {64, 64} };
+
+	FillWallet();
+
+	FUnitTemplate unitTemplate;
+	unitTemplate.UnitKey = TEXT("bench_mine");
+
+	for(const FGridSize& size : sizes)
+	{
+		FMineBenchResult& result = AddResult(FString::Printf(TEXT("generation_%dx%d"), size.Columns, size.Rows), TEXT("setup"));
+
+		int32 runs = FMath::Clamp(20000 / (size.Columns * size.Rows), 5, 200);
+		for(int32 n = 0; n < runs; ++n)
+		{
+			AMineGridUnit* unit = SpawnUnit<AMineGridUnit>(size.Columns, size.Rows, Seed + n);
+			Measure(result, [&]() { unit->Setup(unitTemplate); });
+			DestroyUnit(unit);
+		}
+
+		// Pure data generation for a level's worth of mines, one thread vs all workers
+		const int32 batchSize = 256;
+		TArray<FMineGenParams> params;
+		for(int32 n = 0; n < batchSize; ++n)
+		{
+			FMineGenParams& p = params.AddDefaulted_GetRef();
+			p.Columns = size.Columns;
+			p.MaxUnlockRows = size.Rows;
+			p.ProducerChances.Add(ECurrency::Stone, 1.f);
+			p.ProducerChances.Add(ECurrency::Copper, 0.5f);
+			p.Random.Initialize(Seed + n);
+		}
+
+		FMineBenchResult& sequential = AddResult(result.Scenario, FString::Printf(TEXT("generate_%d_sequential"), batchSize));
+
+		FMineBenchResult& parallel = AddResult(result.Scenario, FString::Printf(TEXT("generate_%d_parallel"), batchSize));
+
+		TArray<FMineGenResult> generated;
+		for(int32 n = 0; n < 5; ++n)
+		{
+			Measure(sequential, [&]()
+			{
+				generated.Reset();
+				generated.SetNum(batchSize);
+				for(int32 idx = 0; idx < batchSize; ++idx)
+					GenerateMine(params[idx], generated[idx]);
+			});
+			Measure(parallel, [&]() { GenerateMines(params, generated); });
+		}
+	}
+}
+
+void UMineBenchmarkCommandlet::BenchRotation()
+{
+	struct FGridSize { int32 Columns; int32 Rows; };
+	const FGridSize sizes[] = { {8, 2}, {16, 16}, {64, 64} };
+	const int32 rotations = 2000;
+
+	FUnitTemplate unitTemplate;
+	unitTemplate.UnitKey = TEXT("bench_mine");
+
+	for(const FGridSize& size : sizes)
+	{
+		for(bool incremental : { true, false })
+		{
+			FillWallet();
+
+			AMineGridUnit* unit = SpawnUnit<AMineGridUnit>(size.Columns, size.Rows, Seed);
+			unit->Setup(unitTemplate);
+			UnlockAll(unit);
+			unit->IncrementalYield = incremental;
+
+			FMineBenchResult& result = AddResult(FString::Printf(TEXT("rotation_%dx%d"), size.Columns, size.Rows), incremental ? TEXT("rotate_incremental") : TEXT("rotate_full"));
+
+			FRandomStream rng(Seed);
+			for(int32 n = 0; n < rotations; ++n)
+			{
+				int32 row = rng.RandRange(0, size.Rows-1);
+				int32 col = rng.RandRange(0, size.Columns-1);
+				Measure(result, [&]() { unit->RotateCellCW(row, col); });
+			}
+			DestroyUnit(unit);
+		}
+
+		// Solving every generated mine has to stay cheap next to generating it
+		AMineGridUnit* unit = SpawnUnit<AMineGridUnit>(size.Columns, size.Rows, Seed);
+		unit->Setup(unitTemplate);
+		UnlockAll(unit);
+
+		FMineBenchResult& solve = AddResult(FString::Printf(TEXT("rotation_%dx%d"), size.Columns, size.Rows), TEXT("solve_rotations"));
+		for(int32 n = 0; n < 10; ++n)
+		{
+			FMineRotationSolution solution;
+			Measure(solve, [&]() { unit->SolveCellRotations(solution, Seed + n); });
+		}
+		DestroyUnit(unit);
+	}
+}
+
+void UMineBenchmarkCommandlet::BenchUnlock()
+{
+	struct FGridSize { int32 Columns; int32 Rows; };
+	const FGridSize sizes[] = { {8, 8}, {16, 32}, {32, 64} };
+
+	FillWallet();
+
+	FUnitTemplate unitTemplate;
+	unitTemplate.UnitKey = TEXT("bench_mine");
+
+	for(const FGridSize& size : sizes)
+	{
+		FMineBenchResult& result = AddResult(FString::Printf(TEXT("unlock_%dx%d"), size.Columns, size.Rows), TEXT("unlock_row"));
+
+		for(int32 n = 0; n < 10; ++n)
+		{
+			AMineGridUnit* unit = SpawnUnit<AMineGridUnit>(size.Columns, size.Rows, Seed + n);
+			unit->Setup(unitTemplate);
+			while(!unit->IsFullyUnlocked())
+			{
+				bool unlocked = false;
+				Measure(result, [&]() { unlocked = unit->UnlockMineRow(); });
+				if(!unlocked) break;
+			}
+			DestroyUnit(unit);
+		}
+	}
+}
+
+void UMineBenchmarkCommandlet::BenchYield()
+{
+	const int32 days = 365;
+	const int32 unitCounts[] = { 16, 128, 1024 };
+
+	FUnitTemplate mineTemplate;
+	mineTemplate.UnitKey = TEXT("bench_mine");
+	FUnitTemplate converterTemplate;
+	converterTemplate.UnitKey = TEXT("bench_converter");
+
+	for(int32 unitCount : unitCounts)
+	{
+		FillWallet();
+
+		// One converter for every eight mines
+		TArray<AGridUnitActor*> units;
+		for(int32 n = 0; n < unitCount; ++n)
+		{
+			if(n % 8 == 7)
+			{
+				AConverterUnitActor* converter = SpawnUnit<AConverterUnitActor>(2, 4, Seed + n);
+				converter->Setup(converterTemplate);
+				UnlockAll(converter);
+				for(int32 r = 0; r < converter->Rows.Num(); ++r)
+					converter->ToggleRowAsProducer(r);
+				units.Add(converter);
+			}
+			else
+			{
+				AMineGridUnit* mine = SpawnUnit<AMineGridUnit>(8, 4, Seed + n);
+				mine->Setup(mineTemplate);
+				UnlockAll(mine);
+				units.Add(mine);
+			}
+		}
+
+		FString scenario = FString::Printf(TEXT("yield_%d_units"), unitCount);
+		FMineBenchResult& result = AddResult(scenario, TEXT("day_tick"));
+		for(int32 day = 0; day < days; ++day)
+		{
+			FillWallet();
+			Measure(result, [&]()
+			{
+				for(AGridUnitActor* unit : units)
+					unit->DoYield();
+			});
+		}
+
+		// What every unit call used to pay before touching the session, against the bound context
+		const int32 lookups = 64;
+		FMineBenchResult& worldLookup = AddResult(scenario, TEXT("session_lookup_world"));
+		FMineBenchResult& contextLookup = AddResult(scenario, TEXT("session_lookup_context"));
+		for(int32 day = 0; day < days; ++day)
+		{
+			Measure(worldLookup, [&]()
+			{
+				for(AGridUnitActor* unit : units)
+				{
+					for(int32 n = 0; n < lookups; ++n)
+						verify(unit->GetWorld()->GetGameInstance<UMineshaftGameInstance>()->SessionManager);
+				}
+			});
+			Measure(contextLookup, [&]()
+			{
+				for(AGridUnitActor* unit : units)
+				{
+					for(int32 n = 0; n < lookups; ++n)
+						verify(unit->GetContext().SessionManager);
+				}
+			});
+		}
+
+		// Only this scenario's units are registered, DestroyUnit unregistered every earlier one
+		FMineBenchResult& batched = AddResult(scenario, TEXT("day_tick_batched"));
+		for(int32 day = 0; day < days; ++day)
+		{
+			FillWallet();
+			Measure(batched, [&]() { GameInstance->DoYieldTick(); });
+		}
+
+		for(AGridUnitActor* unit : units)
+			DestroyUnit(unit);
+	}
+}
+
+void UMineBenchmarkCommandlet::WriteResults(const FString& path)
+{
+	FString csv = TEXT("scenario,op,samples,mean_us,p50_us,p90_us,p99_us,max_us,allocs_per_op\n");
+	for(FMineBenchResult& result : Results)
+	{
+		TArray<double> sorted = result.Samples;
+		sorted.Sort();
+
+		double total = 0.0;
+		for(double sample : sorted)
+			total += sample;
+
+		int32 num = FMath::Max(sorted.Num(), 1);
+		FString line = FString::Printf(TEXT("%s,%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.2f"),
+			*result.Scenario, *result.Op, sorted.Num(),
+			total / num * 1e6,
+			Percentile(sorted, 0.5) * 1e6,
+			Percentile(sorted, 0.9) * 1e6,
+			Percentile(sorted, 0.99) * 1e6,
+			Percentile(sorted, 1.0) * 1e6,
+			static_cast<double>(result.Allocs) / num);
+
+		UE_LOG(MineshaftLog, Display, TEXT("[BENCH] %s"), *line);
+		csv += line + TEXT("\n");
+	}
+
+	if(FFileHelper::SaveStringToFile(csv, *path))
+		UE_LOG(MineshaftLog, Display, TEXT("[BENCH] results written to %s"), *path);
+	else
+		UE_LOG(MineshaftLog, Error, TEXT("[BENCH] failed to write %s"), *path);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+
+#include "MineBenchmarkCommandlet.generated.h"
+
+class AGridUnitActor;
+class AMineGridUnit;
+class UMineshaftGameInstance;
+
+
+// Timings and allocation counts for one benchmarked operation. Allocs are from the measuring thread only.
+struct FMineBenchResult
+{
+	FString Scenario;
+	FString Op;
+	TArray<double> Samples;
+	int64 Allocs = 0;
+};
+
+
+// Headless benchmarks for mine grid logic. Results are written as CSV so runs can be diffed between builds.
+// Usage: UnrealEditor-Cmd <project> -run=MineBenchmark -Rules=<RulesConfig asset> [-Bench=All|Traversal|Maze|Generation|Rotation|Unlock|Yield] [-Seed=1337] [-Out=<csv>]
+UCLASS()
+class MINESHAFT3_API UMineBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UMineBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& params) override;
+
+private:
+	bool SetupSession(const FString& params);
+	void FillWallet();
+
+	template<typename UnitType>
+	UnitType* SpawnUnit(int32 columns, int32 rows, int32 seed);
+	void UnlockAll(AMineGridUnit* unit);
+	void DestroyUnit(AGridUnitActor* unit);
+
+	void BenchTraversal();
+	void BenchMaze();
+	void BenchGeneration();
+	void BenchRotation();
+	void BenchUnlock();
+	void BenchYield();
+
+	// Results are heap allocated so references stay valid while more are added
+	FMineBenchResult& AddResult(const FString& scenario, const FString& op);
+
+	// Time func once and add it as a sample
+	template<typename FuncType>
+	void Measure(FMineBenchResult& result, FuncType&& func);
+
+	void WriteResults(const FString& path);
+
+	UPROPERTY() 
+	UMineshaftGameInstance* GameInstance = nullptr;
+
+	UPROPERTY() 
+	UWorld* World = nullptr;
+
+	TIndirectArray<FMineBenchResult> Results;
+	int32 Seed = 1337;
+};
@@ -0,0 +1,66 @@
+#include "MineBuffInfluence.h"
+
+
+void FMineBuffInfluence::Add(const AGridUnitActor* source, FName key, TArrayView<const FCoordinates> coords, TArray<FCoordinates>& touched)
+{
+	Remove(source, touched);
+
+	FSource& added = Sources.Add(source);
+	added.Key = FindOrAddKey(key);
+	added.Coords.Append(coords.GetData(), coords.Num());
+
+	uint64 bit = 1ull << added.Key;
+	for(const FCoordinates& coord : coords)
+	{
+		FCell& cell = Cells.FindOrAdd(FIntPoint(coord.Col, coord.Row));
+		checkf(cell.Counts[added.Key] < MAX_uint8, TEXT("Too many sources of one buff on a cell"));
+		cell.Counts[added.Key]++;
+		cell.Mask |= bit;
+		touched.AddUnique(coord);
+	}
+}
+
+void FMineBuffInfluence::Remove(const AGridUnitActor* source, TArray<FCoordinates>& touched)
+{
+	FSource removed;
+	if(!Sources.RemoveAndCopyValue(source, removed))
+		return;
+
+	for(const FCoordinates& coord : removed.Coords)
+	{
+		FIntPoint point(coord.Col, coord.Row);
+		FCell& cell = Cells.FindChecked(point);
+		check(cell.Counts[removed.Key] > 0);
+		if(--cell.Counts[removed.Key] == 0)
+		{
+			cell.Mask &= ~(1ull << removed.Key);
+			if(cell.Mask == 0)
+				Cells.Remove(point);
+		}
+		touched.AddUnique(coord);
+	}
+}
+
+uint64 FMineBuffInfluence::GetMask(int32 row, int32 col) const
+{
+	const FCell* cell = Cells.Find(FIntPoint(col, row));
+	return cell ? cell->Mask : 0;
+}
+
+void FMineBuffInfluence::Reset()
+{
+	Keys.Reset();
+	Cells.Reset();
+	Sources.Reset();
+}
+
+int32 FMineBuffInfluence::FindOrAddKey(FName key)
+{
+	int32 bit = Keys.Find(key);
+	if(bit == INDEX_NONE)
+	{
+		checkf(Keys.Num() < MaxKeys, TEXT("Buff influence supports %d buff keys"), MaxKeys);
+		bit = Keys.Add(key);
+	}
+	return bit;
+}
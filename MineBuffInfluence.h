@@ -0,0 +1,65 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "UnitTemplateDataTable.h"
+
+class AGridUnitActor;
+
+
+// Which buffs reach each grid cell. Sources add their footprint once and remove it when they move or clear,
+// so a unit's buff set is one lookup of its cell instead of every buffing unit re-applying.
+struct FMineBuffInfluence
+{
+	static constexpr int32 MaxKeys = 64;
+
+	// Replaces any footprint this source already had. Cells whose buffs changed are added to touched.
+	void Add(const AGridUnitActor* source, FName key, TArrayView<const FCoordinates> coords, TArray<FCoordinates>& touched);
+	void Remove(const AGridUnitActor* source, TArray<FCoordinates>& touched);
+
+	// Bit per buff key, see GetKey
+	uint64 GetMask(int32 row, int32 col) const;
+
+	// Every buff on the cell, repeated once per source, in name order. Buff ops don't commute, so the
+	// order can't depend on which key was registered first.
+	template<typename AllocatorType>
+	void GetBuffs(int32 row, int32 col, TArray<FName, AllocatorType>& buffs) const
+	{
+		const FCell* cell = Cells.Find(FIntPoint(col, row));
+		if(!cell) return;
+
+		TArray<int32, TInlineAllocator<8>> bits;
+		for(uint64 mask = cell->Mask; mask != 0; mask &= mask - 1)
+			bits.Add(FMath::CountTrailingZeros64(mask));
+
+		bits.Sort([this](int32 a, int32 b) { return Keys[a].LexicalLess(Keys[b]); });
+		for(int32 bit : bits)
+		{
+			for(int32 n = 0; n < cell->Counts[bit]; ++n)
+				buffs.Add(Keys[bit]);
+		}
+	}
+
+	FName GetKey(int32 bit) const { return Keys[bit]; }
+
+	void Reset();
+
+private:
+	int32 FindOrAddKey(FName key);
+
+	struct FCell
+	{
+		uint64 Mask = 0;
+		uint8 Counts[MaxKeys] = {};
+	};
+
+	struct FSource
+	{
+		int32 Key = INDEX_NONE;
+		TArray<FCoordinates, TInlineAllocator<16>> Coords;
+	};
+
+	TArray<FName> Keys;
+	TMap<FIntPoint, FCell> Cells;
+	TMap<const AGridUnitActor*, FSource> Sources;
+};
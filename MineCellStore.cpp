@@ -0,0 +1,123 @@
+#include "MineCellStore.h"
+
+
+void FMineCellStore::Init(int32 rows, int32 columns)
+{
+	NumRows = rows;
+	Columns = columns;
+
+	const int32 num = rows * columns;
+	WallVariant.Init(0, num);
+	WallOrientation.Init(0, num);
+	Orientation.Init(ECellOrientation::North, num);
+	Currency.Init(ECurrency::Stone, num);
+	Flags.Init(EMineCellFlags::None, num);
+	MazeLinks.Init(0, num);
+	YieldLinks.Init(0, num);
+	Bank.Init(0.f, num);
+	BankMax.Init(0.f, num);
+	CurrentYield.Init(0.f, num);
+	DistanceToExit.Init(0, num);
+	ExitDir.Init(MineDir::North, num);
+	ChainStart.Init(0, num);
+	ChainNum.Init(0, num);
+	Chains.Reset();
+	LiveChains = 0;
+
+	NeighborMask.SetNumUninitialized(num);
+	for(int32 idx = 0; idx < num; ++idx)
+	{
+		int32 r = RowOf(idx);
+		int32 c = ColOf(idx);
+
+		uint8 mask = 0;
+		if(r > 0)			mask |= MineDir::Bit(MineDir::North);
+		if(c < columns-1)	mask |= MineDir::Bit(MineDir::East);
+		if(r < rows-1)		mask |= MineDir::Bit(MineDir::South);
+		if(c > 0)			mask |= MineDir::Bit(MineDir::West);
+		NeighborMask[idx] = mask;
+	}
+}
+
+void FMineCellStore::MirrorColumns()
+{
+	for(int32 r = 0; r < NumRows; ++r)
+	{
+		// Only need to swap half of the row
+		for(int32 c = 0; c < Columns/2; ++c)
+			SwapCells(Index(r, c), Index(r, Columns-1 - c));
+	}
+
+	for(int32 idx = 0; idx < Num(); ++idx)
+	{
+		// swap east and west bits
+		WallVariant[idx] = MineCellTables::Mirror(WallVariant[idx]);
+		WallOrientation[idx] = MineCellTables::Mirror(WallOrientation[idx]);
+		MazeLinks[idx] = MineCellTables::Mirror(MazeLinks[idx]);
+		YieldLinks[idx] = MineCellTables::Mirror(YieldLinks[idx]);
+	}
+}
+
+ECellOrientation FMineCellStore::Rotate(int32 idx, int32 turnsCW)
+{
+	WallOrientation[idx] = MineCellTables::Rotate(WallOrientation[idx], turnsCW);
+	Orientation[idx] = MineCellTables::RotateOrientation(Orientation[idx], turnsCW);
+	return Orientation[idx];
+}
+
+// Swap everything but the positional neighbor mask
+void FMineCellStore::SwapCells(int32 a, int32 b)
+{
+	WallVariant.Swap(a, b);
+	WallOrientation.Swap(a, b);
+	Orientation.Swap(a, b);
+	Currency.Swap(a, b);
+	Flags.Swap(a, b);
+	MazeLinks.Swap(a, b);
+	YieldLinks.Swap(a, b);
+	Bank.Swap(a, b);
+	BankMax.Swap(a, b);
+	CurrentYield.Swap(a, b);
+	DistanceToExit.Swap(a, b);
+	ExitDir.Swap(a, b);
+	ChainStart.Swap(a, b);
+	ChainNum.Swap(a, b);
+}
+
+void FMineCellStore::SetChains(int32 idx, TArrayView<const FProductionChain> chains)
+{
+	ClearChains(idx);
+	ChainStart[idx] = Chains.Num();
+	ChainNum[idx] = chains.Num();
+	Chains.Append(chains.GetData(), chains.Num());
+	LiveChains += chains.Num();
+}
+
+void FMineCellStore::ClearChains(int32 idx)
+{
+	LiveChains -= ChainNum[idx];
+	ChainNum[idx] = 0;
+}
+
+void FMineCellStore::ResetChains()
+{
+	for(int32 idx = 0; idx < Num(); ++idx)
+		ChainNum[idx] = 0;
+	Chains.Reset();
+	LiveChains = 0;
+}
+
+void FMineCellStore::CompactChains()
+{
+	if(Chains.Num() <= 2 * LiveChains + Num()) return;
+
+	TArray<FProductionChain> live;
+	live.Reserve(LiveChains);
+	for(int32 idx = 0; idx < Num(); ++idx)
+	{
+		int32 start = live.Num();
+		live.Append(Chains.GetData() + ChainStart[idx], ChainNum[idx]);
+		ChainStart[idx] = start;
+	}
+	Chains = MoveTemp(live);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "MineCellTables.h"
+#include "MineEnums.h"
+#include "MineshaftCell.h"
+
+
+// Direction indices match the wall bits, N=0 E=1 S=2 W=3
+namespace MineDir
+{
+	constexpr int32 North = 0;
+	constexpr int32 East = 1;
+	constexpr int32 South = 2;
+	constexpr int32 West = 3;
+	constexpr int32 Num = 4;
+
+	constexpr uint8 Bit(int32 dir) { return static_cast<uint8>(1 << dir); }
+	constexpr int32 Opposite(int32 dir) { return (dir + 2) & 3; }
+	inline ECellOrientation ToOrientation(int32 dir) { return static_cast<ECellOrientation>(dir + 1); }
+}
+
+static_assert(WALL_NORTH == 1 && WALL_EAST == 2 && WALL_SOUTH == 4 && WALL_WEST == 8, "Wall bits must match MineDir indices");
+
+
+enum class EMineCellFlags : uint8
+{
+	None				= 0,
+	Repo				= 1 << 0,
+	Producer			= 1 << 1,
+	InProductiveChain	= 1 << 2,
+};
+ENUM_CLASS_FLAGS(EMineCellFlags);
+
+
+// Contiguous cell storage for a mine. Cells are addressed by index = row * Columns + col.
+// Neighbors, maze links and yield links are 4-bit masks using the wall bits.
+struct FMineCellStore
+{
+	void Init(int32 rows, int32 columns);
+
+	// Flip every row horizontally. Call before orientations are assigned.
+	void MirrorColumns();
+	void SwapCells(int32 a, int32 b);
+
+	// Turn a cell's walls, returns the new orientation
+	ECellOrientation Rotate(int32 idx, int32 turnsCW);
+	ECellOrientation RotateCW(int32 idx) { return Rotate(idx, 1); }
+	ECellOrientation RotateCCW(int32 idx) { return Rotate(idx, 3); }
+
+	EMineCellTrack GetTrackType(int32 idx) const { return MineCellTables::Track(WallVariant[idx]); }
+
+	int32 Num() const { return Flags.Num(); }
+	int32 Index(int32 row, int32 col) const { return row * Columns + col; }
+	int32 RowOf(int32 idx) const { return idx / Columns; }
+	int32 ColOf(int32 idx) const { return idx % Columns; }
+	bool IsValid(int32 row, int32 col) const { return row >= 0 && row < NumRows && col >= 0 && col < Columns; }
+
+	// INDEX_NONE when there is no neighbor in that direction
+	int32 Neighbor(int32 idx, int32 dir) const
+	{
+		if((NeighborMask[idx] & MineDir::Bit(dir)) == 0) return INDEX_NONE;
+
+		const int32 offsets[MineDir::Num] = { -Columns, 1, Columns, -1 };
+		return idx + offsets[dir];
+	}
+
+	bool HasFlag(int32 idx, EMineCellFlags flag) const { return EnumHasAnyFlags(Flags[idx], flag); }
+	bool IsRepo(int32 idx) const { return HasFlag(idx, EMineCellFlags::Repo); }
+	bool IsProducer(int32 idx) const { return HasFlag(idx, EMineCellFlags::Producer); }
+
+	void SetFlag(int32 idx, EMineCellFlags flag, bool value)
+	{
+		if(value) 
+			Flags[idx] |= flag;
+		else 
+			Flags[idx] &= ~flag;
+	}
+
+	// Production chain records of one cell, valid until the chains change
+	TArrayView<const FProductionChain> GetChains(int32 idx) const { return TArrayView<const FProductionChain>(Chains.GetData() + ChainStart[idx], ChainNum[idx]); }
+
+	// Replaces the cell's records. Old records stay in Chains as dead space until CompactChains.
+	void SetChains(int32 idx, TArrayView<const FProductionChain> chains);
+	void ClearChains(int32 idx);
+	void ResetChains();
+
+	// Drop dead space once it outgrows the live records
+	void CompactChains();
+
+	int32 NumRows = 0;
+	int32 Columns = 0;
+
+	TArray<uint8> WallVariant;		// 0-15, initial assignment
+	TArray<uint8> WallOrientation;	// 0-15
+	TArray<ECellOrientation> Orientation;
+	TArray<ECurrency> Currency;
+	TArray<EMineCellFlags> Flags;
+	TArray<uint8> NeighborMask;
+	TArray<uint8> MazeLinks;
+	TArray<uint8> YieldLinks;
+	TArray<float> Bank;
+	TArray<float> BankMax;
+	TArray<float> CurrentYield;
+	TArray<int32> DistanceToExit;
+	TArray<uint8> ExitDir;			// MineDir toward the nearest exit
+
+	// Every cell's chain records in one array, each cell owns ChainNum records from ChainStart
+	TArray<FProductionChain> Chains;
+	TArray<int32> ChainStart;
+	TArray<int32> ChainNum;
+	int32 LiveChains = 0;
+};
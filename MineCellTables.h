@@ -0,0 +1,81 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "MineEnums.h"
+
+
+// Every answer about a 4-bit wall mask, precomputed for all 16 masks. Bits are N=1 E=2 S=4 W=8, a clockwise
+// quarter turn moves each bit to the next direction. Rotating, classifying or mirroring a cell is one load.
+namespace MineCellTables
+{
+	constexpr uint8 RotateOnceCW(uint8 mask) { return static_cast<uint8>(((mask << 1) | (mask >> 3)) & 0xF); }
+
+	constexpr int32 CountBits(uint8 mask) { return (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1); }
+
+	struct FTables
+	{
+		uint8 Rotated[16][4] = {};		// mask after N clockwise turns
+		int8 TurnsCW[16][16] = {};		// clockwise turns from one mask to another, INDEX_NONE if no rotation gets there
+		uint8 Canonical[16] = {};		// smallest mask among the rotations, one per track shape
+		uint8 Mirrored[16] = {};		// east and west swapped
+		EMineCellTrack Track[16] = {};
+	};
+
+	constexpr FTables Build()
+	{
+		FTables tables;
+		for(int32 mask = 0; mask < 16; ++mask)
+		{
+			uint8 rotated = static_cast<uint8>(mask);
+			uint8 canonical = rotated;
+			for(int32 turns = 0; turns < 4; ++turns)
+			{
+				tables.Rotated[mask][turns] = rotated;
+				canonical = rotated < canonical ? rotated : canonical;
+				rotated = RotateOnceCW(rotated);
+			}
+			tables.Canonical[mask] = canonical;
+
+			for(int32 target = 0; target < 16; ++target)
+			{
+				tables.TurnsCW[mask][target] = static_cast<int8>(INDEX_NONE);
+				for(int32 turns = 3; turns >= 0; --turns)
+				{
+					if(tables.Rotated[mask][turns] == target)
+						tables.TurnsCW[mask][target] = static_cast<int8>(turns);
+				}
+			}
+
+			tables.Mirrored[mask] = static_cast<uint8>((mask & 0x5) | ((mask & 0x2) << 2) | ((mask & 0x8) >> 2));
+
+			// Dead ends have no track, producers sit on them
+			int32 openings = CountBits(static_cast<uint8>(mask));
+			if(openings == 4)		tables.Track[mask] = EMineCellTrack::Cross;
+			else if(openings == 3)	tables.Track[mask] = EMineCellTrack::T;
+			else if(openings == 2)	tables.Track[mask] = (mask == 0x5 || mask == 0xA) ? EMineCellTrack::Straight : EMineCellTrack::Curve;
+			else					tables.Track[mask] = EMineCellTrack::None;
+		}
+		return tables;
+	}
+
+	inline constexpr FTables Tables = Build();
+
+	constexpr uint8 Rotate(uint8 mask, int32 turnsCW) { return Tables.Rotated[mask & 0xF][turnsCW & 3]; }
+	constexpr int32 TurnsCW(uint8 from, uint8 to) { return Tables.TurnsCW[from & 0xF][to & 0xF]; }
+	constexpr uint8 Canonical(uint8 mask) { return Tables.Canonical[mask & 0xF]; }
+	constexpr uint8 Mirror(uint8 mask) { return Tables.Mirrored[mask & 0xF]; }
+	constexpr EMineCellTrack Track(uint8 mask) { return Tables.Track[mask & 0xF]; }
+
+	// North=1 .. West=4. None turns as if it were West so a clockwise turn lands on North, as before.
+	constexpr ECellOrientation RotateOrientation(ECellOrientation orientation, int32 turnsCW)
+	{
+		int32 dir = orientation == ECellOrientation::None ? 3 : static_cast<int32>(orientation) - 1;
+		return static_cast<ECellOrientation>(((dir + turnsCW) & 3) + 1);
+	}
+
+	static_assert(Rotate(0x1, 1) == 0x2 && Rotate(0x8, 1) == 0x1 && Rotate(0x3, 3) == 0x9, "Clockwise turns move N to E to S to W");
+	static_assert(TurnsCW(0x5, 0xA) == 1 && TurnsCW(0x3, 0x5) == INDEX_NONE, "Turn counts only between rotations of one shape");
+	static_assert(Canonical(0x2) == 0x1 && Canonical(0x8) == 0x1 && Canonical(0xE) == 0x7 && Canonical(0xC) == 0x3 && Canonical(0xA) == 0x5, "Canonical masks match the old S_WallVariants bases");
+	static_assert(Mirror(0x2) == 0x8 && Mirror(0x7) == 0xD, "Mirroring swaps east and west");
+}
@@ -0,0 +1,85 @@
+#include "MineConversionSolver.h"
+#include "ConverterUnitActor.h"
+
+
+void FMineConversionSolver::Solve(TArrayView<AConverterUnitActor* const> converters, const FCurrencyVector& wallet)
+{
+	Demand.Reset();
+	for(AConverterUnitActor* converter : converters)
+		converter->AddInputDemand(Demand);
+
+	Ratios = MakeRatios(Demand, wallet);
+}
+
+FCurrencyVector FMineConversionSolver::MakeRatios(const FCurrencyVector& demand, const FCurrencyVector& wallet)
+{
+	FCurrencyVector ratios;
+	for(int32 lane = 0; lane < MineCurrencyLanes; ++lane)
+	{
+		ECurrency currency = static_cast<ECurrency>(lane);
+		if(!demand.Contains(currency)) continue;
+
+		float available = FMath::Max(0.f, wallet.Amounts[lane]);
+		ratios.Set(currency, available < demand.Amounts[lane] ? available / demand.Amounts[lane] : 1.f);
+	}
+	return ratios;
+}
+
+// Per currency with demand D, wallet W and income R per tick:
+//   full ticks while W + t*(R - D) >= D, then one tick taking what's left, then R per tick (full if R >= D).
+// Splitting at every currency's phase boundaries leaves spans where each ratio is constant.
+void FMineConversionSolver::ForEachSpan(int32 ticks, const FCurrencyVector& demand, const FCurrencyVector& wallet, const FCurrencyVector& incomePerTick,
+	TFunctionRef<void(const FCurrencyVector& ratios, int32 spanTicks)> visit)
+{
+	if(ticks <= 0)
+		return;
+
+	int32 fullTicks[MineCurrencyLanes];
+	TArray<int32, TInlineAllocator<2 * MineCurrencyLanes + 1>> bounds = { ticks };
+	for(int32 lane = 0; lane < MineCurrencyLanes; ++lane)
+	{
+		fullTicks[lane] = ticks;
+		if(!demand.Contains(static_cast<ECurrency>(lane))) continue;
+
+		float d = demand.Amounts[lane];
+		float w = wallet.Amounts[lane];
+		float r = incomePerTick.Amounts[lane];
+		if(w < d)
+			fullTicks[lane] = 0;
+		else if(r < d)
+			fullTicks[lane] = static_cast<int32>(FMath::Min<double>(ticks, FMath::FloorToDouble((w - d) / (d - r)) + 1.0));
+
+		if(fullTicks[lane] < ticks)
+		{
+			bounds.Add(fullTicks[lane]);
+			bounds.Add(fullTicks[lane] + 1);
+		}
+	}
+	bounds.Sort();
+
+	int32 start = 0;
+	for(int32 end : bounds)
+	{
+		end = FMath::Min(end, ticks);
+		if(end <= start) continue;
+
+		FCurrencyVector ratios;
+		for(int32 lane = 0; lane < MineCurrencyLanes; ++lane)
+		{
+			ECurrency currency = static_cast<ECurrency>(lane);
+			if(!demand.Contains(currency)) continue;
+
+			float d = demand.Amounts[lane];
+			float r = incomePerTick.Amounts[lane];
+			if(start < fullTicks[lane])
+				ratios.Set(currency, 1.f);
+			else if(start == fullTicks[lane])
+				ratios.Set(currency, FMath::Max(0.f, wallet.Amounts[lane] + start * (r - d)) / d);
+			else
+				ratios.Set(currency, FMath::Min(1.f, FMath::Max(0.f, r) / d));
+		}
+
+		visit(ratios, end - start);
+		start = end;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "MineCurrency.h"
+
+class AConverterUnitActor;
+
+
+// Shares scarce input currency across every converter row in the session. Rows consuming the same
+// currency all get the same fill ratio, so evaluation order doesn't matter and the wallet is never overspent.
+// Converters draw exactly demand * ratio, their buffs and tech only scale what they produce.
+struct FMineConversionSolver
+{
+	// One pass over all producing rows, then one ratio per input currency
+	void Solve(TArrayView<AConverterUnitActor* const> converters, const FCurrencyVector& wallet);
+
+	const FCurrencyVector& GetDemand() const { return Demand; }
+	const FCurrencyVector& GetRatios() const { return Ratios; }
+
+	// min(1, wallet / demand) for each currency with demand
+	static FCurrencyVector MakeRatios(const FCurrencyVector& demand, const FCurrencyVector& wallet);
+
+	// Closed form for N ticks of a constant demand, the wallet at the first tick and a constant income per tick.
+	// Each currency runs full, then one partial tick, then starves to its income. Visits spans of constant ratios.
+	static void ForEachSpan(int32 ticks, const FCurrencyVector& demand, const FCurrencyVector& wallet, const FCurrencyVector& incomePerTick,
+		TFunctionRef<void(const FCurrencyVector& ratios, int32 spanTicks)> visit);
+
+private:
+	FCurrencyVector Demand;
+	FCurrencyVector Ratios;
+};
@@ -0,0 +1,36 @@
+#include "MineCurrency.h"
+
+
+TMap<ECurrency, float> FCurrencyVector::ToMap() const
+{
+	TMap<ECurrency, float> ret;
+	for(int32 lane = 0; lane < MineCurrencyLanes; ++lane)
+	{
+		if(Present & (1u << lane))
+			ret.Add(static_cast<ECurrency>(lane), Amounts[lane]);
+	}
+	return ret;
+}
+
+FCurrencyVector FCurrencyVector::FromMap(const TMap<ECurrency, float>& amounts)
+{
+	FCurrencyVector ret;
+	for(auto& amt : amounts)
+		ret.Set(amt.Key, amt.Value);
+	return ret;
+}
+
+TMap<ECurrency, float> UCurrencyVectorLibrary::CurrencyVectorToMap(const FCurrencyVector& amounts)
+{
+	return amounts.ToMap();
+}
+
+FCurrencyVector UCurrencyVectorLibrary::MapToCurrencyVector(const TMap<ECurrency, float>& amounts)
+{
+	return FCurrencyVector::FromMap(amounts);
+}
+
+float UCurrencyVectorLibrary::GetCurrencyAmount(const FCurrencyVector& amounts, ECurrency currency)
+{
+	return amounts.Get(currency);
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+
+#include "MineEnums.h"
+
+#include "MineCurrency.generated.h"
+
+
+// One lane per ECurrency value. Raise this if ECurrency grows past it, the game instance checks the full enum on setup.
+constexpr int32 MineCurrencyLanes = 8;
+
+static_assert(MineCurrencyLanes <= 32, "Present masks hold one bit per lane");
+static_assert(static_cast<int32>(ECurrency::Stone) < MineCurrencyLanes && static_cast<int32>(ECurrency::Copper) < MineCurrencyLanes
+	&& static_cast<int32>(ECurrency::Iron) < MineCurrencyLanes && static_cast<int32>(ECurrency::Gold) < MineCurrencyLanes, "ECurrency outgrew MineCurrencyLanes");
+
+inline int32 CurrencyLane(ECurrency currency)
+{
+	int32 lane = static_cast<int32>(currency);
+	check(lane >= 0 && lane < MineCurrencyLanes);
+	return lane;
+}
+
+
+// A compiled buff step: amount = amount * Multiply + Add on one currency lane
+struct FMineBuffOp
+{
+	FMineBuffOp() = default;
+	FMineBuffOp(ECurrency currency, float multiply, float add)
+		: Lane(static_cast<uint8>(CurrencyLane(currency)))
+		, Present(add != 0.f ? 1u << CurrencyLane(currency) : 0u)
+		, Multiply(multiply)
+		, Add(add)
+	{}
+
+	uint8 Lane = 0;
+	uint32 Present = 0;		// Adding creates the currency in the total, multiplying doesn't
+	float Multiply = 1.f;
+	float Add = 0.f;
+};
+
+
+// Dense amount per currency, replaces TMap<ECurrency, float> on the yield and wallet paths.
+// Present tracks which lanes have been written so conversions back to a map keep the same keys.
+USTRUCT(BlueprintType)
+struct FCurrencyVector
+{
+	GENERATED_BODY()
+
+	float Get(ECurrency currency) const { return Amounts[CurrencyLane(currency)]; }
+	bool Contains(ECurrency currency) const { return (Present & (1u << CurrencyLane(currency))) != 0; }
+	bool IsEmpty() const { return Present == 0; }
+
+	void Add(ECurrency currency, float amount)
+	{
+		int32 lane = CurrencyLane(currency);
+		Amounts[lane] += amount;
+		Present |= 1u << lane;
+	}
+
+	void Set(ECurrency currency, float amount)
+	{
+		int32 lane = CurrencyLane(currency);
+		Amounts[lane] = amount;
+		Present |= 1u << lane;
+	}
+
+	void Reset()
+	{
+		for(int32 lane = 0; lane < MineCurrencyLanes; ++lane)
+			Amounts[lane] = 0.f;
+		Present = 0;
+	}
+
+	FCurrencyVector& operator+=(const FCurrencyVector& other)
+	{
+		for(int32 lane = 0; lane < MineCurrencyLanes; ++lane)
+			Amounts[lane] += other.Amounts[lane];
+		Present |= other.Present;
+		return *this;
+	}
+
+	FCurrencyVector& operator-=(const FCurrencyVector& other)
+	{
+		for(int32 lane = 0; lane < MineCurrencyLanes; ++lane)
+			Amounts[lane] -= other.Amounts[lane];
+		Present |= other.Present;
+		return *this;
+	}
+
+	void Scale(float scale)
+	{
+		for(int32 lane = 0; lane < MineCurrencyLanes; ++lane)
+			Amounts[lane] *= scale;
+	}
+
+	void Clamp(float min, float max)
+	{
+		for(int32 lane = 0; lane < MineCurrencyLanes; ++lane)
+			Amounts[lane] = FMath::Clamp(Amounts[lane], min, max);
+	}
+
+	void ApplyBuffs(TArrayView<const FMineBuffOp> ops)
+	{
+		for(const FMineBuffOp& op : ops)
+		{
+			Amounts[op.Lane] = Amounts[op.Lane] * op.Multiply + op.Add;
+			Present |= op.Present;
+		}
+	}
+
+	TMap<ECurrency, float> ToMap() const;
+	static FCurrencyVector FromMap(const TMap<ECurrency, float>& amounts);
+
+	alignas(16) float Amounts[MineCurrencyLanes] = {};
+	uint32 Present = 0;
+};
+
+
+UCLASS()
+class MINESHAFT3_API UCurrencyVectorLibrary : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+
+public:
+	UFUNCTION(BlueprintPure, Category="Currency") 
+	static TMap<ECurrency, float> CurrencyVectorToMap(const FCurrencyVector& amounts);
+
+	UFUNCTION(BlueprintPure, Category="Currency") 
+	static FCurrencyVector MapToCurrencyVector(const TMap<ECurrency, float>& amounts);
+
+	UFUNCTION(BlueprintPure, Category="Currency") 
+	static float GetCurrencyAmount(const FCurrencyVector& amounts, ECurrency currency);
+};
@@ -0,0 +1,129 @@
+#include "MineGeneration.h"
+#include "Async/ParallelFor.h"
+
+
+struct FCurrencyWeight
+{
+	ECurrency Currency = ECurrency::Stone;
+	float Weight = 0.f;
+};
+
+
+void GenerateMine(const FMineGenParams& params, FMineGenResult& result)
+{
+	FRandomStream random = params.Random;
+	FMineCellStore& store = result.Store;
+	const int32 columns = params.Columns;
+
+	// Determine currency in a producer cell. Favor the UnlockCurrency with configurable weights 
+	TMap<ECurrency, TArray<FCurrencyWeight>> weights;
+	TArray<FCurrencyWeight> cws;
+
+	// ensure order of keys
+	TArray<ECurrency> keys;
+	params.ProducerChances.GetKeys(keys);
+	
+	float totalWeight = 0.f;
+	for(auto& k : keys)
+		totalWeight += params.ProducerChances[k];
+
+	float weightSum = 0.f;
+	for(auto& k : keys)
+	{
+		weightSum += params.ProducerChances[k];
+		FCurrencyWeight cw;
+		cw.Currency = k;
+		cw.Weight = weightSum / totalWeight;
+		check(cw.Weight > 0.f);
+		check(cw.Weight <= 1.f);
+		cws.Add(cw);
+	}
+	weights.Add(params.UnlockCurrency, cws);
+
+	result.TotalProducers = 0;
+	auto set_as_producer = [&](int32 cell)
+	{
+		// Producer cells have a Bank of currency to be drawn from
+		result.TotalProducers++;
+		store.SetFlag(cell, EMineCellFlags::Producer, true);
+		store.Bank[cell] = random.FRandRange(params.BankInitialMin, params.BankInitialMax);
+		store.BankMax[cell] = store.Bank[cell];
+	};
+
+	// Initialize cell properties
+	store.Init(params.MaxUnlockRows, columns);
+	result.UnlockCosts.Reset(params.MaxUnlockRows);
+	for(int32 jdx = 0; jdx < params.MaxUnlockRows; ++jdx)
+	{
+		// Unlock costs. First row has UnlockCost = 0
+		float baseCost = params.UnlockBaseCost;
+		int32 upgradeIndex = FMath::Max(0, jdx - 1);
+		result.UnlockCosts.Add(static_cast<int32>(baseCost + (baseCost * upgradeIndex * params.UpgradeBaseMultiplier)));
+
+		for(int32 idx = 0; idx < columns; ++idx)
+		{
+			// Currency assignment
+			ECurrency& currency = store.Currency[store.Index(jdx, idx)];
+			currency = ECurrency::Stone;
+			float currencyRNG = random.FRand();
+			TArray<FCurrencyWeight>& cw = weights[params.UnlockCurrency];
+			for(auto& c : cw)
+			{
+				if(currencyRNG < c.Weight)
+				{
+					currency = c.Currency;
+					break;
+				}
+			}
+		}
+	}
+
+	// Maze assignment
+	GetMazeCarver(params.MazeAlgorithm)(store, random);
+
+	// REPO node - Ensure we have an output on our top row
+	// Set repo node. Random cell in top row, exclude 0 index
+	int32 repoCell = store.Index(0, random.RandHelper(columns - 1) + 1);
+	store.SetFlag(repoCell, EMineCellFlags::Repo, true);
+	store.WallVariant[repoCell] = WALL_NORTH | WALL_EAST | WALL_SOUTH | WALL_WEST;
+
+	// Mirror the mineshaft 50% of the time for visual variation.
+	// Need to do this before orientations are assigned
+	if(random.FRand() < 0.5f)
+		store.MirrorColumns();
+
+	// Cell wall setup. Maze links share the wall bits.
+	for(int32 idx = 0; idx < store.Num(); ++idx)
+		store.WallVariant[idx] |= store.MazeLinks[idx];
+
+	// Set properties after maze has been generated
+	for(int32 idx = 0; idx < store.Num(); ++idx)
+	{
+		int32 wallVariant = store.WallVariant[idx];
+		store.WallOrientation[idx] = wallVariant;
+		store.Orientation[idx] = ECellOrientation::North;
+
+		if(params.RotateTracks)
+			store.Rotate(idx, random.RandHelper(4));
+		
+		// Dead ends, every single opening rotates to north
+		if(MineCellTables::Canonical(wallVariant) == WALL_NORTH)
+			set_as_producer(idx);
+
+		// Binary tree carve cannot generate a cross, the others can
+		check(store.IsRepo(idx) || (wallVariant != 15) || params.MazeAlgorithm != EMineMazeAlgorithm::BinaryTree);
+	}
+
+	result.Random = random;
+}
+
+void GenerateMines(TArrayView<const FMineGenParams> params, TArray<FMineGenResult>& results)
+{
+	results.Reset();
+	results.SetNum(params.Num());
+
+	ParallelFor(params.Num(), [&](int32 idx)
+	{
+		GenerateMine(params[idx], results[idx]);
+	});
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "MineCellStore.h"
+#include "MineEnums.h"
+#include "MineMazeGenerators.h"
+
+
+// Everything mine generation reads. Plain data so generation can run off the game thread.
+struct FMineGenParams
+{
+	int32 Columns = 8;
+	int32 MaxUnlockRows = 2;
+	ECurrency UnlockCurrency = ECurrency::Stone;
+	float UnlockBaseCost = 20.f;
+	float UpgradeBaseMultiplier = 1.f;
+	float BankInitialMin = 200.f;
+	float BankInitialMax = 300.f;
+	TMap<ECurrency, float> ProducerChances;
+	bool RotateTracks = true;
+	EMineMazeAlgorithm MazeAlgorithm = EMineMazeAlgorithm::BinaryTree;
+
+	// Seeded from the unit, generation draws everything from this stream
+	FRandomStream Random;
+};
+
+struct FMineGenResult
+{
+	FMineCellStore Store;
+	TArray<float> UnlockCosts;
+	int32 TotalProducers = 0;
+
+	// Stream state after generation, handed back to the unit
+	FRandomStream Random;
+};
+
+
+// Maze, currency assignment, producer banks, wall variants and initial rotations
+void GenerateMine(const FMineGenParams& params, FMineGenResult& result);
+
+// Generate every mine across worker threads. Results are in params order.
+void GenerateMines(TArrayView<const FMineGenParams> params, TArray<FMineGenResult>& results);
@@ -1,252 +1,92 @@
 
 #include "MineGridUnit.h"
+#include "ConverterUnitActor.h"
 #include "MineshaftGameInstance.h"
 #include "TechLabUnitActor.h"
 
 
-struct FCurrencyWeight
-{
-	ECurrency Currency = ECurrency::Stone;
-	float Weight = 0.f;
-};
-
-
 void AMineGridUnit::Setup(const FUnitTemplate& unitTemplate)
 {
-	// Determine currency in a producer cell. Favor the UnlockCurrency with configurable weights 
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	USessionManager* sm = gi->SessionManager;
-	USessionRules* rules = sm->GetRules();
-	
-	TMap<ECurrency, TArray<FCurrencyWeight>> weights;
-	TArray<FCurrencyWeight> cws;
-
-	// ensure order of keys
-	TArray<ECurrency> keys;
-	ProducerChances.GetKeys(keys);
-	
-	float totalWeight = 0.f;
-	for(auto& k : keys)
-		totalWeight += ProducerChances[k];
-
-	float weightSum = 0.f;
-	for(auto& k : keys)
-	{
-		weightSum += ProducerChances[k];
-		FCurrencyWeight cw;
-		cw.Currency = k;
-		cw.Weight = weightSum / totalWeight;
-		check(cw.Weight > 0.f);
-		check(cw.Weight <= 1.f);
-		cws.Add(cw);
-	}
-	weights.Add(UnlockCurrency, cws);
+	FMineGenResult result;
+	GenerateMine(MakeGenParams(unitTemplate), result);
+	FinishSetup(unitTemplate, MoveTemp(result));
+}
 
-	TotalProducers = 0;
-	auto set_as_producer = [&](UMineshaftCell* cell)
-	{
-		// Producer cells have a Bank of currency to be drawn from
-		TotalProducers++;
-		cell->Producer = true;
-		cell->Bank = FMath::RandRange(BankInitialMin, BankInitialMax);
-		cell->BankMax = cell->Bank;
-	};
+// Generate the mines on worker threads, then bind each one on the game thread
+void AMineGridUnit::SetupBatch(TArrayView<AMineGridUnit* const> units, TArrayView<const FUnitTemplate> unitTemplates)
+{
+	check(IsInGameThread());
+	check(units.Num() == unitTemplates.Num());
 
-	// Initialize cell properties
-	for(int32 jdx = 0; jdx < MaxUnlockRows; ++jdx)
+	TArray<FMineGenParams> params;
+	params.Reserve(units.Num());
+	for(int32 idx = 0; idx < units.Num(); ++idx)
 	{
-		FMineRow row;
-
-		// Unlock costs. First row has UnlockCost = 0
-		float baseCost = UnlockBaseCost;
-		int32 upgradeIndex = FMath::Max(0, jdx - 1);
-		row.UnlockCost = static_cast<int32>(baseCost + (baseCost * upgradeIndex * rules->UpgradeBaseMultiplier));
-		row.UnlockCurrency = UnlockCurrency;
-
-		for(int32 idx = 0; idx < Columns; ++idx)
-		{
-			UMineshaftCell* cell = NewObject<UMineshaftCell>(this);
-			cell->Row = jdx;
-			cell->Col = idx;
-
-			// Currency assignment
-			cell->Currency = ECurrency::Stone;
-			float currencyRNG = FMath::FRand();
-			TArray<FCurrencyWeight>& cw = weights[UnlockCurrency];
-			for(auto& c : cw)
-			{
-				if(currencyRNG < c.Weight)
-				{
-					cell->Currency = c.Currency;
-					break;
-				}
-			}
-			
-			row.Cells.Add(cell);
-		}
-		Rows.Add(row);
+		// Converters build their rows in their own Setup, there is nothing to generate
+		check(!units[idx]->IsA<AConverterUnitActor>());
+		params.Add(units[idx]->MakeGenParams(unitTemplates[idx]));
 	}
 
-	// Maze assignment
-	auto link = [](UMineshaftCell* a, UMineshaftCell* b)
-	{
-		a->Links.Add(b);
-		b->Links.Add(a);
-	};
-
-	for(int32 r = Rows.Num()-1; r >= 0; --r)
-	{
-		auto& row = Rows[r];
-		for(int32 c = 0; c < row.Cells.Num(); ++c)
-		{
-			UMineshaftCell* current = row.Cells[c];
-			UMineshaftCell* next = nullptr;
-
-			// Always carve right on the final row
-			if(r == 0)
-			{
-				if(c < row.Cells.Num()-1)
-				{
-					next = Rows[r].Cells[c+1];
-					check(next);
-					link(next, current);
-				}
-				continue;
-			}
-
-			if( (c == 0) ||
-				((c < row.Cells.Num()-1) && FMath::FRand() < 0.5f) ) 
-			{
-				// carve right
-				next = Rows[r].Cells[c+1];
-			}
-			else
-			{
-				// carve up on final column
-				next = Rows[r-1].Cells[c];
-			}
-			
-			check(next);
-			link(next, current);
-		}
-	}
+	TArray<FMineGenResult> results;
+	GenerateMines(params, results);
 
-	// REPO node - Ensure we have an output on our top row
-	auto& toprow = Rows[0];
-	
-	// Set repo node. Random cell in top row, exclude 0 index
-	UMineshaftCell* repoCell = toprow.Cells[(FMath::Rand() % (Columns - 1)) + 1];
-	check(repoCell->WallVariant != WALL_NORTH && repoCell->WallVariant != WALL_EAST && repoCell->WallVariant != WALL_SOUTH && repoCell->WallVariant != WALL_WEST);
-	repoCell->Repo = true;
-	repoCell->WallVariant = WALL_NORTH | WALL_EAST | WALL_SOUTH | WALL_WEST;
+	for(int32 idx = 0; idx < units.Num(); ++idx)
+		units[idx]->FinishSetup(unitTemplates[idx], MoveTemp(results[idx]));
+}
 
-	// Gaurentee a connection to our top producer by carving left on everythign between the repo and edge producer
-	for(int32 col = repoCell->Col; col > 0; --col)
-	{
-		auto current = GetCell(0, col);
-		auto next = GetCell(0, col-1);
-		link(current, next);
-	}
+FMineGenParams AMineGridUnit::MakeGenParams(const FUnitTemplate& unitTemplate)
+{
+	SeedRandom();
 
-	// Mirror the mineshaft 50% of the time for visual variation.
-	// Need to do this before Neighbor assignments or orientations will be backwards
-	if(FMath::FRand() < 0.5f)
-	{
-		for(auto& row : Rows)
-		{
-			// Only need to swap half of the array
-			for(int32 idx = 0; idx < (row.Cells.Num()/2); ++idx)
-			{
-				int32 swapIdx = row.Cells.Num()-1 - idx;
-				int32 c1 = row.Cells[swapIdx]->Col;
-				int32 c2 = row.Cells[idx]->Col;
-				UMineshaftCell* temp = row.Cells[swapIdx];
-				row.Cells[swapIdx] = row.Cells[idx];
-				row.Cells[swapIdx]->Col = c1;
-				row.Cells[idx] = temp;
-				row.Cells[idx]->Col = c2;
-			}
-		}
-	}
-	
-	// Neighbor assignment
-	for (int32 r = 0; r < Rows.Num(); r++)
-	{
-		for (int32 c = 0; c < Rows[r].Cells.Num(); c++)
-		{
-			UMineshaftCell* cell = GetCell(r, c);
-			
-			if (!cell) continue;
-
-			cell->Neighbors.Add(ECellOrientation::North, GetCell(r-1, c));
-			cell->Neighbors.Add(ECellOrientation::East,  GetCell(r, c+1));
-			cell->Neighbors.Add(ECellOrientation::South, GetCell(r+1, c));
-			cell->Neighbors.Add(ECellOrientation::West,  GetCell(r, c-1));
-		}
-	}
-
-	// Cell wall setup
-	for(auto& row : Rows)
-	{
-		for(auto& c : row.Cells)
-		{
-			if (c->Links.Contains(c->Neighbors[ECellOrientation::North]))  c->WallVariant |= WALL_NORTH;
-			if (c->Links.Contains(c->Neighbors[ECellOrientation::East]))   c->WallVariant |= WALL_EAST;
-			if (c->Links.Contains(c->Neighbors[ECellOrientation::South]))  c->WallVariant |= WALL_SOUTH;
-			if (c->Links.Contains(c->Neighbors[ECellOrientation::West]))   c->WallVariant |= WALL_WEST;
-		}
-	}
+	const FGridUnitContext& ctx = GetContext();
+	USessionRules* rules = ctx.Rules;
 
 	//@TECH Perfection Skill
-	for(UTechNode* tech : sm->ActiveTech)
+	if(ctx.GameInstance->GetTechCache().Has(unitTemplate.UnitKey, ETechTrait::Perfection))
 	{
-		if(tech->Trait != ETechTrait::Perfection) continue;
-		if(tech->UnitKey != unitTemplate.UnitKey) continue;
-
 		PickupTracksOnRowUnlock = false;
 		RotateTracksOnSetup = false;
 		SwapTracksOnSetup = false;
 	}
-	
-	// Set properties after maze has been generated
-	for(auto& row : Rows)
-	{
-		for(auto& c : row.Cells)
-		{
-			//@OPTIMIZE break this track type assignment to a funciton
-			c->TrackType = UMineshaftCell::S_TrackTypes[c->WallVariant];
-			c->WallOrientation = c->WallVariant;
-			c->Orientation = ECellOrientation::North;
 
-			if(RotateTracksOnSetup)
-			{
-				int32 rand = FMath::Rand() % 4;
-				for(int32 n = 0; n < rand; ++n)
-					RotateCellCW(c, false);
-			}
-			
-			if (c->WallVariant == WALL_NORTH
-				|| c->WallVariant == WALL_EAST
-				|| c->WallVariant == WALL_SOUTH
-				|| c->WallVariant == WALL_WEST)
-			{
-				set_as_producer(c);
-			}
-
-			// Binary tree carve cannot generate a cross
-			check(c->Repo || (c->WallVariant != 15));
-		}
+	FMineGenParams params;
+	params.Columns = Columns;
+	params.MaxUnlockRows = MaxUnlockRows;
+	params.UnlockCurrency = UnlockCurrency;
+	params.UnlockBaseCost = UnlockBaseCost;
+	params.UpgradeBaseMultiplier = rules->UpgradeBaseMultiplier;
+	params.BankInitialMin = BankInitialMin;
+	params.BankInitialMax = BankInitialMax;
+	params.ProducerChances = ProducerChances;
+	params.RotateTracks = RotateTracksOnSetup;
+	params.MazeAlgorithm = MazeAlgorithm;
+	params.Random = Random;
+	return params;
+}
+
+void AMineGridUnit::FinishSetup(const FUnitTemplate& unitTemplate, FMineGenResult&& result)
+{
+	UMineshaftGameInstance* gi = GetContext().GameInstance;
+
+	Random = result.Random;
+	StoreRandomState();
+	BankModel = DepletingBankModel;
+	CellStore = MoveTemp(result.Store);
+	TotalProducers = result.TotalProducers;
+	SavedBanks = CellStore.Bank;
+
+	for(float unlockCost : result.UnlockCosts)
+	{
+		FMineRow row;
+		row.UnlockCost = unlockCost;
+		row.UnlockCurrency = UnlockCurrency;
+		Rows.Add(row);
 	}
 
-	//@TECH Guilded tech, auto rank up
-	int32 rowUnlocks = InitialRowUnlocks;
-	for(UTechNode* tech : sm->ActiveTech)
-	{
-		if(tech->Trait != ETechTrait::Guilded) continue;
-		if(tech->UnitKey != unitTemplate.UnitKey) continue;
+	BindCellViews();
 
-		rowUnlocks++;
-	}
+	//@TECH Guilded tech, auto rank up
+	int32 rowUnlocks = InitialRowUnlocks + gi->GetTechCache().GetCount(unitTemplate.UnitKey, ETechTrait::Guilded);
 
 	// Unlock initial row, calculates our Yield
 	UnlockedProducers = 0;
@@ -260,77 +100,124 @@ void AMineGridUnit::Setup(const FUnitTemplate& unitTemplate)
 	Super::Setup(unitTemplate);
 }
 
-void AMineGridUnit::DoYield()
+// Both the single unit and batched ticks land here after paying out
+void AMineGridUnit::OnYieldTick()
 {
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	USessionManager* sm = gi->SessionManager;
-
-	// Calculate CurrentYield during CalculateYield(). We need to factor in YieldMultiplier there.
-	TMap<ECurrency, float> total;
-	SumYieldAmount(total);
-	sm->AddToWallet(total);
+	if(IsDepletingBanks())
+		DrainBanks();
 
-	Super::DoYield();
+	Super::OnYieldTick();
 }
 
 void AMineGridUnit::Refresh()
 {
+	RestoreSavedBanks();
 	CalculateYield();
 	Super::Refresh();
 }
 
-// Rotate CW
-ECellOrientation AMineGridUnit::RotateCellCW(UMineshaftCell* cell, bool calcYield /*= true*/)
+ECellOrientation AMineGridUnit::RotateCellIndexCW(int32 cell, bool calcYield /*= true*/)
 {
-	cell->WallOrientation = cell->WallOrientation << 1;
-	int32 mask = 15; //all walls
-	int32 carry = cell->WallOrientation & (~mask);
-	if (carry > 0)
-	{
-		cell->WallOrientation -= carry; //remove carry
-		cell->WallOrientation += 1; // move to the right most bit
-	}
-	
-	int32 raw = static_cast<int32>(cell->Orientation);
-	raw = raw == 4 ? 1 : raw + 1;
-	cell->Orientation = static_cast<ECellOrientation>(raw);
+	ECellOrientation orientation = CellStore.RotateCW(cell);
 
 	if(calcYield)
-		CalculateYield();
+		CalculateYieldForCell(cell);
 	
-	return cell->Orientation;
+	return orientation;
 }
 
-// Rotate CCW
-ECellOrientation AMineGridUnit::RotateCellCCW(UMineshaftCell* cell, bool calcYield /*= true*/)
+ECellOrientation AMineGridUnit::RotateCellIndexCCW(int32 cell, bool calcYield /*= true*/)
 {
-	int32 carry = cell->WallOrientation & 1;
-	cell->WallOrientation = cell->WallOrientation >> 1;
-	if (carry > 0)
-		cell->WallOrientation += 8; // add left most bit
-	
-	int32 raw = static_cast<int32>(cell->Orientation);
-	raw = raw == 1 ? 4 : raw - 1;
-	cell->Orientation = static_cast<ECellOrientation>(raw);
+	ECellOrientation orientation = CellStore.RotateCCW(cell);
 
 	if(calcYield)
-		CalculateYield();
+		CalculateYieldForCell(cell);
 	
-	return cell->Orientation;
+	return orientation;
 }
 
 ECellOrientation AMineGridUnit::RotateCellCW(int32 row, int32 col)
 {
-	auto& r = Rows[row];
-	auto& cell = r.Cells[col];
-	return RotateCellCW(cell);
+	return RotateCellIndexCW(CellStore.Index(row, col));
 }
 
 ECellOrientation AMineGridUnit::RotateCellCCW(int32 row, int32 col)
 {
-	auto& r = Rows[row];
-	auto& cell = r.Cells[col];
-	return RotateCellCCW(cell);
+	return RotateCellIndexCCW(CellStore.Index(row, col));
+}
+
+void AMineGridUnit::SolveCellRotations(FMineRotationSolution& solution, int32 seed /*= 0*/) const
+{
+	FMineRotationSolveParams params;
+	params.Seed = seed;
+	params.Active.Init(false, CellStore.Num());
+	for(int32 cell = 0; cell < CellStore.Num(); ++cell)
+		params.Active[cell] = Rows[CellStore.RowOf(cell)].Unlocked;
+
+	SolveRotations(CellStore, params, solution);
+}
+
+const FMineRotationSolution& AMineGridUnit::GetSolvedRotations() const
+{
+	uint32 layout = GetRotationLayoutHash();
+	if(!bRotationSolutionCached || layout != CachedRotationLayout)
+	{
+		SolveCellRotations(CachedRotationSolution);
+		CachedRotationLayout = layout;
+		bRotationSolutionCached = true;
+	}
+	return CachedRotationSolution;
+}
+
+int32 AMineGridUnit::GetBestFoundConnectedProducers() const
+{
+	return GetSolvedRotations().ConnectedProducers;
+}
+
+int32 AMineGridUnit::GetConnectedProducersUpperBound() const
+{
+	return GetSolvedRotations().UpperBound;
+}
+
+bool AMineGridUnit::IsRotationSolutionOptimal() const
+{
+	return GetSolvedRotations().IsOptimal();
+}
+
+// Everything SolveRotations reads: walls, repos, producers with bank left, unlocked rows
+uint32 AMineGridUnit::GetRotationLayoutHash() const
+{
+	uint32 hash = GetTypeHash(CellStore.Num());
+	for(int32 cell = 0; cell < CellStore.Num(); ++cell)
+	{
+		uint32 bits = CellStore.WallOrientation[cell]
+			| (CellStore.IsRepo(cell) ? 0x10 : 0)
+			| (CellStore.IsProducer(cell) && CellStore.Bank[cell] > 0.f ? 0x20 : 0)
+			| (Rows[CellStore.RowOf(cell)].Unlocked ? 0x40 : 0);
+		hash = HashCombine(hash, bits);
+	}
+	return hash;
+}
+
+void AMineGridUnit::ApplySolvedRotations()
+{
+	const FMineRotationSolution& solution = GetSolvedRotations();
+
+	bool changed = false;
+	for(int32 cell = 0; cell < CellStore.Num(); ++cell)
+	{
+		if(solution.TurnsCW[cell] == 0) continue;
+
+		CellStore.Rotate(cell, solution.TurnsCW[cell]);
+		changed = true;
+	}
+
+	if(!changed) return;
+
+	// The applied layout is its own solution, keep it cached rather than solving it again
+	CachedRotationSolution.TurnsCW.Init(0, CellStore.Num());
+	CalculateYield();
+	CachedRotationLayout = GetRotationLayoutHash();
 }
 
 int32 AMineGridUnit::GetUnlockLevel()
@@ -351,8 +238,7 @@ bool AMineGridUnit::CanUnlock()
 		return false;
 	
 	auto& row = Rows[levelToUnlock];
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	auto& wallet = gi->SessionManager->Wallet.Amounts;
+	auto& wallet = GetContext().SessionManager->Wallet.Amounts;
 	return wallet.Contains(row.UnlockCurrency) ? wallet[row.UnlockCurrency] >= row.UnlockCost : false;
 }
 
@@ -364,20 +250,19 @@ bool AMineGridUnit::UnlockMineRow()
 	int32 unlockLevel = GetUnlockLevel();
 	int32 levelToUnlock = unlockLevel + 1;
 	auto& row = Rows[levelToUnlock];
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	gi->SessionManager->UpdateWallet(row.UnlockCurrency, -row.UnlockCost);
+	GetContext().SessionManager->UpdateWallet(row.UnlockCurrency, -row.UnlockCost);
 	row.Unlocked = true;
 
 	// Pickup our tracks and place in inventory
 	if(PickupTracksOnRowUnlock)
 	{
-		for(auto& cell : row.Cells) 
-			PickupTrack(cell->Row, cell->Col, false);
+		for(int32 col = 0; col < CellStore.Columns; ++col) 
+			PickupTrack(levelToUnlock, col, false);
 	}
 
-	for(auto& cell : row.Cells)
+	for(int32 col = 0; col < CellStore.Columns; ++col)
 	{
-		if(cell->Producer)
+		if(CellStore.IsProducer(CellStore.Index(levelToUnlock, col)))
 			UnlockedProducers++;
 	}
 	
@@ -432,371 +317,594 @@ UMineshaftCell* AMineGridUnit::GetCell(int32 row, int32 col)
 	return nullptr;
 }
 
+TArray<UMineshaftCell*> AMineGridUnit::GetActiveProducerCells()
+{
+	TArray<UMineshaftCell*> ret;
+	for(int32 prod : ActiveProducers)
+		ret.Add(GetCell(CellStore.RowOf(prod), CellStore.ColOf(prod)));
+	return ret;
+}
+
 void AMineGridUnit::ClearCellWalls(int32 row, int32 col)
 {
-	UMineshaftCell* cell = GetCell(row, col);
+	if(!CellStore.IsValid(row, col)) return;
 
-	if(!cell) return;
+	int32 cell = CellStore.Index(row, col);
 
 	// Design: Never clear producers
-	check(!cell->Producer);
+	check(!CellStore.IsProducer(cell));
 
-	cell->TrackType = EMineCellTrack::None;
-	cell->WallVariant = 0;
-	cell->WallOrientation = 0;
-	cell->Orientation = ECellOrientation::North;
+	CellStore.WallVariant[cell] = 0;
+	CellStore.WallOrientation[cell] = 0;
+	CellStore.Orientation[cell] = ECellOrientation::North;
 }
 
-void AMineGridUnit::SwapCellProperties(UMineshaftCell* a, UMineshaftCell* b, UMineshaftCell* buffer)
+// Create the Blueprint views for each cell in the store
+void AMineGridUnit::BindCellViews()
 {
-	auto copy = [](UMineshaftCell* cl, UMineshaftCell* cr)
+	for(int32 r = 0; r < Rows.Num(); ++r)
 	{
-		cl->Currency = cr->Currency;
-		cl->Bank = cr->Bank;
-		cl->BankMax = cr->BankMax;
-		cl->TrackType = cr->TrackType;
-		cl->WallVariant = cr->WallVariant;
-		cl->WallOrientation = cr->WallOrientation;
-		cl->Orientation = cr->Orientation;
-		cl->Repo = cr->Repo;
-		cl->Producer = cr->Producer;
-		cl->Links = cr->Links;
-		cl->Neighbors = cr->Neighbors;
-	};
+		auto& cells = Rows[r].Cells;
+		cells.Reset(CellStore.Columns);
+		for(int32 c = 0; c < CellStore.Columns; ++c)
+		{
+			UMineshaftCell* view = NewObject<UMineshaftCell>(this);
+			view->Bind(this, CellStore.Index(r, c));
+			cells.Add(view);
+		}
+	}
+}
 
-	copy(buffer, a);
-	copy(a, b);
-	copy(b, buffer);
+void AMineGridUnit::SwapCellProperties(int32 a, int32 b)
+{
+	CellStore.SwapCells(a, b);
 }
 
 ECellOrientation AMineGridUnit::GetOrientation(UMineshaftCell* from, UMineshaftCell* to)
 {
-	// we're assuming these cells are adjacent
-	if(from->Row > to->Row) return ECellOrientation::North;
-	if(from->Row < to->Row) return ECellOrientation::South;
-	if(from->Col < to->Col) return ECellOrientation::East;
-	if(from->Col > to->Col) return ECellOrientation::West;
-	return ECellOrientation::None;
+	return GetOrientation(from->Index, to->Index);
 }
 
-void AMineGridUnit::CalculateDistanceToExit(UMineshaftCell* cell, TSet<UMineshaftCell*>& vst, int32 distance)
+ECellOrientation AMineGridUnit::GetOrientation(int32 from, int32 to) const
 {
-	if(vst.Contains(cell)) return;
-
-	vst.Add(cell);
-	cell->DistanceToExit = distance;
-	for(auto& link : cell->YieldLinks)
-		CalculateDistanceToExit(link.Value, vst, distance+1);
+	// we're assuming these cells are adjacent
+	int32 fromRow = CellStore.RowOf(from);
+	int32 toRow = CellStore.RowOf(to);
+	if(fromRow > toRow) return ECellOrientation::North;
+	if(fromRow < toRow) return ECellOrientation::South;
+	if(from < to) return ECellOrientation::East;
+	if(from > to) return ECellOrientation::West;
+	return ECellOrientation::None;
 }
 
-void AMineGridUnit::SetShortestPathToExit(UMineshaftCell* current, UMineshaftCell* prev, ECurrency currency /*=ECurrency::Money*/)
+// Multi-source breadth first search from every exit, DistanceToExit is the shortest link distance to any of them.
+// ExitDir points each cell at its parent, one step closer to an exit. Order receives the cells nearest first.
+void AMineGridUnit::CalculateDistanceToExit(const TArray<int32>& exitRepos, TArray<int32>& order)
 {
-	check(current);
-	current->InProductiveChain = true;
-
-	// Determine origin and exit of producer
-	FProductionChain chain;
-	if(!prev)
+	order.Reset();
+	PathTraversal.Begin(CellStore.Num());
+	for(int32 exitRepo : exitRepos)
 	{
-		check(current->Producer);
-		chain.Origin = ECellOrientation::None;
-		chain.Currency = current->Currency;
+		if(PathTraversal.Visit(exitRepo))
+			CellStore.DistanceToExit[exitRepo] = 0;
 	}
-	else
-	{
-		chain.Origin = GetOrientation(current, prev);
-		chain.Currency = currency;
-	}
-
-	if(current->Repo)
-		return;
 
-	UMineshaftCell* next = nullptr;
-	if(current->DistanceToExit > 0)
+	while(PathTraversal.HasNext())
 	{
-		int32 shortest = TNumericLimits<int32>::Max();
-		for(auto& link : current->YieldLinks)
+		int32 cell = PathTraversal.Next();
+		order.Add(cell);
+
+		int32 distance = CellStore.DistanceToExit[cell] + 1;
+		for(int32 dir = 0; dir < MineDir::Num; ++dir)
 		{
-			if(link.Value->DistanceToExit < shortest)
+			if((CellStore.YieldLinks[cell] & MineDir::Bit(dir)) == 0) continue;
+
+			int32 link = CellStore.Neighbor(cell, dir);
+			if(PathTraversal.Visit(link))
 			{
-				shortest = link.Value->DistanceToExit;
-				next = link.Value;
+				CellStore.DistanceToExit[link] = distance;
+				CellStore.ExitDir[link] = MineDir::Opposite(dir);
 			}
 		}
 	}
-	chain.Exit = next ? GetOrientation(current, next) : ECellOrientation::North;
-	current->ProductionChains.Add(chain);
-
-	if(next)
-		SetShortestPathToExit(next, current, chain.Currency);
 }
 
-void AMineGridUnit::CalculateYield()
+// Route producers to their nearest exit along the ExitDir tree. Flow is summed per cell
+// so trunk cells hold one chain record per origin and currency rather than one per producer.
+void AMineGridUnit::BuildProductionChains(const TArray<int32>& order)
 {
-	check(Rows.Num() > 0);
-	
-	// reset all cells
-	for (int32 r = 0; r < Rows.Num(); r++)
+	TArray<FProductionChain, TInlineAllocator<16>> chains;
+
+	// Farthest cells first so every inbound cell's records are final before a cell gathers them
+	for(int32 idx = order.Num()-1; idx >= 0; --idx)
 	{
-		if (!Rows[r].Unlocked) continue;
+		int32 cell = order[idx];
 
-		for (int32 c = 0; c < Rows[r].Cells.Num(); c++)
+		// Repos are the end of the chain, they are flagged but hold no records
+		if(CellStore.IsRepo(cell)) continue;
+
+		int32 exitDir = CellStore.ExitDir[cell];
+		ECellOrientation exit = MineDir::ToOrientation(exitDir);
+
+		chains.Reset();
+		if(CellStore.IsProducer(cell) && CellStore.Bank[cell] > 0.f)
 		{
-			Rows[r].Cells[c]->YieldLinks.Empty();
-			Rows[r].Cells[c]->ProductionChains.Empty();
+			FProductionChain& chain = chains.AddDefaulted_GetRef();
+			chain.Origin = ECellOrientation::None;
+			chain.Exit = exit;
+			chain.Currency = CellStore.Currency[cell];
 		}
-	}
 
-	// cell neighbors/links
-	// Find our active repo nodes
-	TArray<UMineshaftCell*> repos;
-	for (int32 r = 0; r < Rows.Num(); r++)
-	{
-		if(!Rows[r].Unlocked) continue;
-		
-		for (int32 c = 0; c < Rows[r].Cells.Num(); c++)
+		// Inbound flow from linked neighbors whose exit is this cell
+		for(int32 dir = 0; dir < MineDir::Num; ++dir)
 		{
-			auto& cell = Rows[r].Cells[c];
+			if((CellStore.YieldLinks[cell] & MineDir::Bit(dir)) == 0) continue;
 
-			if(cell->Repo)
-				repos.Add(cell);
-			
-			cell->InProductiveChain = false;
+			int32 from = CellStore.Neighbor(cell, dir);
+			if(CellStore.IsRepo(from) || CellStore.ExitDir[from] != MineDir::Opposite(dir)) continue;
 
-			// link NORTH
-			if((cell->WallOrientation & WALL_NORTH) > 0 && !cell->YieldLinks.Contains(ECellOrientation::North))
+			ECellOrientation origin = MineDir::ToOrientation(dir);
+			for(const FProductionChain& chain : CellStore.GetChains(from))
 			{
-				UMineshaftCell* neighbor = GetCell(r-1, c);
-				if(neighbor && (neighbor->WallOrientation & WALL_SOUTH) > 0)
+				FProductionChain* inbound = chains.FindByPredicate([&](const FProductionChain& c)
 				{
-					cell->YieldLinks.Add(ECellOrientation::North, neighbor);
-					neighbor->YieldLinks.Add(ECellOrientation::South, cell);
-				}
-			}
-			
-			// link EAST
-			if((cell->WallOrientation & WALL_EAST) > 0 && !cell->YieldLinks.Contains(ECellOrientation::East))
-			{
-				UMineshaftCell* neighbor = GetCell(r, c+1);
-				if(neighbor && (neighbor->WallOrientation & WALL_WEST) > 0)
-				{
-					cell->YieldLinks.Add(ECellOrientation::East, neighbor);
-					neighbor->YieldLinks.Add(ECellOrientation::West, cell);
-				}
-			}
-			
-			// link SOUTH
-			if((cell->WallOrientation & WALL_SOUTH) > 0 && !cell->YieldLinks.Contains(ECellOrientation::South))
-			{
-				UMineshaftCell* neighbor = GetCell(r+1, c);
-				if(neighbor && (neighbor->WallOrientation & WALL_NORTH) > 0)
-				{
-					cell->YieldLinks.Add(ECellOrientation::South, neighbor);
-					neighbor->YieldLinks.Add(ECellOrientation::North, cell);
-				}
-			}
-			
-			// link WEST
-			if((cell->WallOrientation & WALL_WEST) > 0 && !cell->YieldLinks.Contains(ECellOrientation::West))
-			{
-				UMineshaftCell* neighbor = GetCell(r, c-1);
-				if(neighbor && (neighbor->WallOrientation & WALL_EAST) > 0)
+					return c.Origin == origin && c.Currency == chain.Currency;
+				});
+
+				if(!inbound)
 				{
-					cell->YieldLinks.Add(ECellOrientation::West, neighbor);
-					neighbor->YieldLinks.Add(ECellOrientation::East, cell);
+					inbound = &chains.AddDefaulted_GetRef();
+					inbound->Origin = origin;
+					inbound->Exit = exit;
+					inbound->Currency = chain.Currency;
+					inbound->Count = 0;
 				}
+				inbound->Count += chain.Count;
 			}
 		}
+
+		if(chains.Num() == 0) continue;
+
+		CellStore.SetChains(cell, chains);
+		CellStore.SetFlag(cell, EMineCellFlags::InProductiveChain, true);
+
+		int32 next = CellStore.Neighbor(cell, exitDir);
+		if(CellStore.IsRepo(next))
+			CellStore.SetFlag(next, EMineCellFlags::InProductiveChain, true);
+	}
+}
+
+void AMineGridUnit::LinkCell(int32 cell)
+{
+	uint8 links = 0;
+
+	// Link to unlocked neighbors with an opening facing back at us
+	if(Rows[CellStore.RowOf(cell)].Unlocked)
+	{
+		for(int32 dir = 0; dir < MineDir::Num; ++dir)
+		{
+			if((CellStore.WallOrientation[cell] & MineDir::Bit(dir)) == 0) continue;
+
+			int32 neighbor = CellStore.Neighbor(cell, dir);
+			if(neighbor == INDEX_NONE || !Rows[CellStore.RowOf(neighbor)].Unlocked) continue;
+
+			if(CellStore.WallOrientation[neighbor] & MineDir::Bit(MineDir::Opposite(dir)))
+				links |= MineDir::Bit(dir);
+		}
 	}
 
+	CellStore.YieldLinks[cell] = links;
+}
+
+// Expects Traversal to have been started by the caller. Components share its visited set.
+void AMineGridUnit::EvaluateComponent(int32 repo)
+{
 	// Walk each cell, breath first search for total count
-	// Calc Mineshsaft Yields
 	// Using REPO nodes, calucluate productive chains of PRODUCER nodes
+	TArray<int32> producers;
+	TArray<int32> exitRepos;
 
-	ActiveProducers.Empty();
-	TSet<UMineshaftCell*> visitedCells;
-	for(auto& repo : repos)
+	Traversal.Continue();
+	Traversal.Visit(repo);
+	while (Traversal.HasNext())
 	{
-		if(visitedCells.Contains(repo)) continue;
+		int32 c = Traversal.Next();
+		check(Rows[CellStore.RowOf(c)].Unlocked);
 
-		TArray<UMineshaftCell*> producers;
-		TArray<UMineshaftCell*> toVisit = { repo };
-		TArray<UMineshaftCell*> exitRepos = { repo };
+		// Producer cell
+		if (CellStore.IsProducer(c) && CellStore.Bank[c] > 0.f)
+			producers.Add(c);
 
-		while (toVisit.Num() > 0)
+		// Check if c is a REPO cell
+		if(CellStore.IsRepo(c))
+			exitRepos.Add(c);
+
+		for(int32 dir = 0; dir < MineDir::Num; ++dir)
 		{
-			auto c = toVisit[0];
-			toVisit.RemoveAt(0);
+			if((CellStore.YieldLinks[c] & MineDir::Bit(dir)) == 0) continue;
 
-			if (visitedCells.Contains(c)) continue;
+			Traversal.Visit(CellStore.Neighbor(c, dir));
+		}
+	}
 
-			auto& row = Rows[c->Row];
-			if(!row.Unlocked) continue;
+	// Flag this chain as productive. Sum our total exits
+	if(producers.Num() > 0)
+	{
+		ActiveProducers.Append(producers);
 
-			visitedCells.Add(c);
+		TArray<int32> order;
+		CalculateDistanceToExit(exitRepos, order);
+		BuildProductionChains(order);
+	}
+}
 
-			// Producer cell
-			if (c->Producer && c->Bank > 0.f)
-				producers.Add(c);
+void AMineGridUnit::UpdateProducerYields()
+{
+	check(ActiveProducers.Num() <= TotalProducers);
+	for(int32 prod : ActiveProducers)
+	{
+		check(CellStore.Bank[prod] > 0.f);
+		CellStore.CurrentYield[prod] = FMath::Min(YieldBase, CellStore.Bank[prod]); 
+	}
 
-			// Check if c is a REPO cell
-			if(c->Repo)
-				exitRepos.Add(c);
+	RebuildDepletionQueue();
+	InvalidateYield();
 
-			for (auto& link : c->YieldLinks)
-			{
-				if (visitedCells.Contains(link.Value)) continue;
+	GetContext().SessionManager->YieldUpdated();
+}
 
-				toVisit.Add(link.Value);
-			}
-		}
+// Banks above YieldBase pay the full amount until floor(Bank / YieldBase) ticks have passed.
+// At that tick the producer either ran dry or has a partial last draw left.
+int32 AMineGridUnit::PredictDepletionTick(int32 cell) const
+{
+	int32 fullTicks = FMath::FloorToInt(CellStore.Bank[cell] / YieldBase);
+	return YieldTicks + FMath::Max(1, fullTicks);
+}
 
-		// Flag this chain as productive. Sum our total exits
-		if(producers.Num() > 0)
-		{
-			ActiveProducers.Append(producers);
+void AMineGridUnit::RebuildDepletionQueue()
+{
+	DepletionQueue.Reset();
+	if(!IsDepletingBanks() || YieldBase <= 0.f) return;
 
-			for(auto& exitRepo : exitRepos)
-			{
-				TSet<UMineshaftCell*> visited;
-				CalculateDistanceToExit(exitRepo, visited, 0);
+	for(int32 prod : ActiveProducers)
+		DepletionQueue.Add({ PredictDepletionTick(prod), prod });
 
-				for(auto& prod : producers)
-					SetShortestPathToExit(prod, nullptr);
-			}
-		}
+	DepletionQueue.Heapify();
+}
+
+// Banks drained before a save, CalculateYield rebuilds the depletion queue from them
+void AMineGridUnit::RestoreSavedBanks()
+{
+	if(!IsDepletingBanks() || SavedBanks.Num() != CellStore.Num()) return;
+
+	CellStore.Bank = SavedBanks;
+}
+
+// Callers draining more than one tick must stop at the next depletion event, see FastForward
+void AMineGridUnit::DrainBanks(int32 ticks /*= 1*/)
+{
+	check(ticks <= GetTicksToNextYieldChange());
+	YieldTicks += ticks;
+
+	// Saves from before banks were persisted start tracking from the live banks
+	if(SavedBanks.Num() != CellStore.Num())
+		SavedBanks = CellStore.Bank;
+
+	for(int32 prod : ActiveProducers)
+	{
+		float& bank = CellStore.Bank[prod];
+		bank -= CellStore.CurrentYield[prod] * ticks;
+		if(bank < KINDA_SMALL_NUMBER)
+			bank = 0.f;
+
+		SavedBanks[prod] = bank;
 	}
 
-	check(ActiveProducers.Num() <= TotalProducers);
-	for(auto& prod : ActiveProducers)
+	// Producers whose yield changes this tick
+	TArray<int32, TInlineAllocator<8>> dry;
+	bool partial = false;
+	while(DepletionQueue.Num() > 0 && DepletionQueue.HeapTop().Tick <= YieldTicks)
 	{
-		check(prod->Bank > 0.f);
-		prod->CurrentYield = FMath::Min(YieldBase, prod->Bank); 
+		FMineDepletionEvent event;
+		DepletionQueue.HeapPop(event, false);
+
+		if(CellStore.Bank[event.Cell] <= 0.f)
+		{
+			CellStore.CurrentYield[event.Cell] = 0.f;
+			dry.Add(event.Cell);
+			continue;
+		}
+
+		// Partial draw, or float drift left the bank a tick short of the prediction
+		CellStore.CurrentYield[event.Cell] = FMath::Min(YieldBase, CellStore.Bank[event.Cell]);
+		DepletionQueue.HeapPush({ PredictDepletionTick(event.Cell), event.Cell });
+		partial = true;
 	}
 
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	gi->SessionManager->YieldUpdated();
+	// Links don't change, only the components holding dry producers need their chains rebuilt
+	if(dry.Num() > 0)
+		RecalculateComponents(dry);
+	else if(partial)
+		InvalidateYield();
 }
 
-void AMineGridUnit::SumYieldAmount(TMap<ECurrency, float>& totals)
+int32 AMineGridUnit::GetTicksToNextYieldChange() const
 {
-	GetTotalYieldByRef(totals);
+	if(!IsDepletingBanks() || DepletionQueue.Num() == 0)
+		return MAX_int32;
+
+	return FMath::Max(1, DepletionQueue.HeapTop().Tick - YieldTicks);
 }
 
-// yield buffs
-const TMap<FName, void(AMineGridUnit::*)(TMap<ECurrency, float>&)> AMineGridUnit::S_Buffs =
+FCurrencyVector AMineGridUnit::FastForward(int32 ticks)
 {
-	{ "buff_stone", 	&AMineGridUnit::Buff_StoneOutput },
-	{ "buff_copper", 	&AMineGridUnit::Buff_CopperOutput },
-	{ "buff_iron", 		&AMineGridUnit::Buff_IronOutput },
-	{ "buff_gold", 		&AMineGridUnit::Buff_GoldOutput },
-	{ "buff_gold2", 	&AMineGridUnit::Buff_GoldMultiplier },
-};
+	FCurrencyVector delta;
+	while(ticks > 0)
+	{
+		int32 span = FMath::Min(ticks, GetTicksToNextYieldChange());
 
+		FCurrencyVector segment = GetCachedYield();
+		segment.Scale(static_cast<float>(span));
+		delta += segment;
 
-void AMineGridUnit::GetTotalYieldByRef(TMap<ECurrency, float>& total)
+		if(IsDepletingBanks())
+			DrainBanks(span);
+
+		ticks -= span;
+	}
+	return delta;
+}
+
+void AMineGridUnit::CalculateYield()
 {
-	for(auto& prod : ActiveProducers)
+	check(Rows.Num() > 0);
+	
+	// reset all cells, relink and find our active repo nodes
+	TArray<int32> repos;
+	CellStore.ResetChains();
+	for (int32 cell = 0; cell < CellStore.Num(); ++cell)
 	{
-		if(!total.Contains(prod->Currency))
-			total.Add(prod->Currency, 0.f);
+		CellStore.SetFlag(cell, EMineCellFlags::InProductiveChain, false);
+		LinkCell(cell);
 
-		total[prod->Currency] += prod->CurrentYield;		
+		if(CellStore.IsRepo(cell) && Rows[CellStore.RowOf(cell)].Unlocked)
+			repos.Add(cell);
 	}
 
-	// Apply yield buffs
-	for(FName& key : Buffs)
+	ActiveProducers.Reset();
+	Traversal.Begin(CellStore.Num());
+	for(int32 repo : repos)
 	{
-		if(S_Buffs.Contains(key))
-			(this->*S_Buffs[key])(total);
+		if(Traversal.Visited.Contains(repo)) continue;
+		EvaluateComponent(repo);
 	}
 
-	//@TECH Efficient: Apply tech traits
-	float techBonus = 0.f;
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	USessionManager* sm = gi->SessionManager;
-	for(auto& tech : sm->ActiveTech)
+	UpdateProducerYields();
+}
+
+// Only the rotated cell and its neighbors can change links. Re-evaluate the components they belonged to.
+void AMineGridUnit::CalculateYieldForCell(int32 cell)
+{
+	if(!IncrementalYield)
+	{
+		CalculateYield();
+		return;
+	}
+
+	if(!Rows[CellStore.RowOf(cell)].Unlocked)
 	{
-		if(tech->Trait != ETechTrait::Efficient) continue;
-		if(tech->UnitKey != UnitKey) continue;
+		// Locked cells are never linked, nothing to recompute
+		UpdateProducerYields();
+		return;
+	}
 
-		techBonus += tech->TraitValue;
+	TArray<int32, TInlineAllocator<MineDir::Num + 1>> touched = { cell };
+	for(int32 dir = 0; dir < MineDir::Num; ++dir)
+	{
+		int32 neighbor = CellStore.Neighbor(cell, dir);
+		if(neighbor != INDEX_NONE && Rows[CellStore.RowOf(neighbor)].Unlocked)
+			touched.Add(neighbor);
 	}
 
-	if(techBonus > 0.f)
+	RecalculateComponents(touched);
+
+	if(CrossCheckIncrementalYield)
+		CrossCheckYield();
+}
+
+// Relink the touched cells and re-evaluate every component they belonged to. Touched cells must be unlocked.
+void AMineGridUnit::RecalculateComponents(TArrayView<const int32> touched)
+{
+	// Gather the old components of every touched cell. Any split or merge stays inside this region.
+	TArray<int32> repos;
+	Traversal.Begin(CellStore.Num());
+	for(int32 c : touched)
+		Traversal.Visit(c);
+
+	while(Traversal.HasNext())
 	{
-		for(auto& amt : total)
-			amt.Value = amt.Value * (1 + techBonus);
+		int32 c = Traversal.Next();
+		CellStore.ClearChains(c);
+		CellStore.SetFlag(c, EMineCellFlags::InProductiveChain, false);
+
+		if(CellStore.IsRepo(c))
+			repos.Add(c);
+
+		for(int32 dir = 0; dir < MineDir::Num; ++dir)
+		{
+			if(CellStore.YieldLinks[c] & MineDir::Bit(dir))
+				Traversal.Visit(CellStore.Neighbor(c, dir));
+		}
 	}
+	ActiveProducers.RemoveAllSwap([&](int32 prod) { return Traversal.Visited.Contains(prod); });
+
+	for(int32 c : touched)
+		LinkCell(c);
+
+	// Visit repos in the same row-major order as CalculateYield so each component is evaluated identically
+	repos.Sort();
+
+	Traversal.Begin(CellStore.Num());
+	for(int32 repo : repos)
+	{
+		if(Traversal.Visited.Contains(repo)) continue;
+		EvaluateComponent(repo);
+	}
+	CellStore.CompactChains();
+
+	UpdateProducerYields();
 }
 
-TMap<ECurrency, float> AMineGridUnit::GetTotalYield()
+// Debug: rerun the full pass and assert it matches the incremental result
+void AMineGridUnit::CrossCheckYield()
 {
-	TMap<ECurrency, float> ret;
-	GetTotalYieldByRef(ret);
-	return ret;
+	TArray<int32> producers = ActiveProducers;
+	TArray<EMineCellFlags> flags = CellStore.Flags;
+	TArray<float> currentYield = CellStore.CurrentYield;
+	TArray<uint8> yieldLinks = CellStore.YieldLinks;
+	TArray<TArray<FProductionChain>> productionChains;
+	for(int32 cell = 0; cell < CellStore.Num(); ++cell)
+	{
+		TArrayView<const FProductionChain> chains = CellStore.GetChains(cell);
+		productionChains.Emplace(chains.GetData(), chains.Num());
+	}
+
+	CalculateYield();
+
+	TArray<int32> expected = ActiveProducers;
+	producers.Sort();
+	expected.Sort();
+	checkf(producers == expected, TEXT("Incremental yield mismatch: active producers"));
+
+	for(int32 cell = 0; cell < CellStore.Num(); ++cell)
+	{
+		checkf(flags[cell] == CellStore.Flags[cell]
+			&& currentYield[cell] == CellStore.CurrentYield[cell]
+			&& yieldLinks[cell] == CellStore.YieldLinks[cell]
+			&& TArrayView<const FProductionChain>(productionChains[cell]) == CellStore.GetChains(cell),
+			TEXT("Incremental yield mismatch at [%d, %d]"), CellStore.RowOf(cell), CellStore.ColOf(cell));
+	}
 }
 
-bool AMineGridUnit::HasYield()
+void AMineGridUnit::SumYieldAmount(FCurrencyVector& totals)
 {
-	return ActiveProducers.Num() > 0;
+	totals += GetCachedYield();
 }
 
-float AMineGridUnit::GetActiveProducerPercent()
+// yield buffs, compiled into FMineBuffOps when buffs change
+const TMap<FName, TArray<FMineBuffOp>> AMineGridUnit::S_Buffs =
 {
-	float pct = static_cast<float>(ActiveProducers.Num()) / static_cast<float>(UnlockedProducers);
-	return pct >= 0.999f ? 1.0f : pct;
+	{ "buff_stone", 	{ FMineBuffOp(ECurrency::Stone,  2.f, 0.f) } },
+	{ "buff_copper", 	{ FMineBuffOp(ECurrency::Copper, 1.f, 25.f) } },
+	{ "buff_iron", 		{ FMineBuffOp(ECurrency::Iron,   2.f, 0.f) } },
+	{ "buff_gold", 		{ FMineBuffOp(ECurrency::Gold,   1.f, 5.f) } },
+	{ "buff_gold2", 	{ FMineBuffOp(ECurrency::Gold,   3.f, 0.f) } },
+};
+
+void AMineGridUnit::CompileBuffs()
+{
+	// Same order however the buffs were added, see FMineBuffInfluence::GetBuffs
+	TArray<FName, TInlineAllocator<8>> keys(Buffs);
+	keys.Sort(FNameLexicalLess());
+
+	CompiledBuffs.Reset();
+	for(const FName& key : keys)
+	{
+		if(const TArray<FMineBuffOp>* ops = S_Buffs.Find(key))
+			CompiledBuffs.Append(*ops);
+	}
+
+	InvalidateYield();
 }
 
-void AMineGridUnit::ApplyBuffs()
+// Callers may have already added to total, e.g. converter rows
+void AMineGridUnit::GetTotalYieldVectorByRef(FCurrencyVector& total)
+{
+	// Converters and Blueprints read here directly, not only through GetCachedYield
+	FlushBuffs();
+
+	for(int32 prod : ActiveProducers)
+		total.Add(CellStore.Currency[prod], CellStore.CurrentYield[prod]);
+
+	// Apply yield buffs
+	total.ApplyBuffs(CompiledBuffs);
+
+	//@TECH Efficient: Apply tech traits
+	float techBonus = GetContext().GameInstance->GetTechCache().GetValue(UnitKey, ETechTrait::Efficient);
+	if(techBonus > 0.f)
+		total.Scale(1.f + techBonus);
+}
+
+void AMineGridUnit::GetTotalYieldByRef(TMap<ECurrency, float>& total)
 {
-	UMineshaftGameInstance* gi = GetWorld()->GetGameInstance<UMineshaftGameInstance>();
-	USessionManager* sm = gi->SessionManager;
+	FCurrencyVector amounts = FCurrencyVector::FromMap(total);
+	GetTotalYieldVectorByRef(amounts);
+	total = amounts.ToMap();
+}
+
+const FCurrencyVector& AMineGridUnit::GetCachedYield()
+{
+	// Buffs added this frame are compiled on first read rather than per AddBuff
+	FlushBuffs();
+
+	// GetTechCache invalidates registered mines on a rebuild, the version compare also covers unregistered ones
+	uint32 techVersion = GetContext().GameInstance->GetTechCache().GetVersion();
 
-	for(auto& coord : BuffCoords)
+	if(bYieldDirty || techVersion != CachedTechVersion || !IsYieldCacheable())
 	{
-		AGridCellActor* cell = sm->GetGridCell(coord.Row, coord.Col);
-		if(cell && cell->UnitActor)
-			cell->UnitActor->AddBuff(BuffKey);
+		CachedYield.Reset();
+		GetTotalYieldVectorByRef(CachedYield);
+		CachedTechVersion = techVersion;
+		bYieldDirty = false;
 	}
+
+	return CachedYield;
 }
 
-void AMineGridUnit::Buff_StoneOutput(TMap<ECurrency, float>& total)
+// Widgets bound to YieldChangedDelegate re-query on the next GetTotalYield
+void AMineGridUnit::InvalidateYield()
 {
-	ECurrency c = ECurrency::Stone;
-	if(total.Contains(c))
-		total[c] *= 2.f;
+	bYieldDirty = true;
+	YieldChangedDelegate.Broadcast(this);
 }
 
-void AMineGridUnit::Buff_CopperOutput(TMap<ECurrency, float>& total)
+TMap<ECurrency, float> AMineGridUnit::GetTotalYield()
 {
-	ECurrency c = ECurrency::Copper;
-	if(!total.Contains(c))
-		total.Add(c, 0.f);
-	
-	total[c] += 25.f;
+	return GetCachedYield().ToMap();
 }
 
-void AMineGridUnit::Buff_IronOutput(TMap<ECurrency, float>& total)
+FCurrencyVector AMineGridUnit::GetTotalYieldVector()
 {
-	ECurrency c = ECurrency::Iron;
-	if(total.Contains(c))
-		total[c] *= 2.f;
+	return GetCachedYield();
 }
 
-void AMineGridUnit::Buff_GoldOutput(TMap<ECurrency, float>& total)
+float AMineGridUnit::GetYieldAmount(ECurrency currency)
 {
-	ECurrency c = ECurrency::Gold;
-	if(!total.Contains(c))
-		total.Add(c, 0.f);
-	
-	total[c] += 5.f;
+	return GetCachedYield().Get(currency);
+}
+
+bool AMineGridUnit::HasYieldCurrency(ECurrency currency)
+{
+	return GetCachedYield().Contains(currency);
 }
 
-void AMineGridUnit::Buff_GoldMultiplier(TMap<ECurrency, float>& total)
+bool AMineGridUnit::HasYield()
 {
-	ECurrency c = ECurrency::Gold;
-	if(total.Contains(c))
-		total[c] *= 3.f;
+	return ActiveProducers.Num() > 0;
 }
 
+float AMineGridUnit::GetActiveProducerPercent()
+{
+	if(UnlockedProducers == 0)
+		return 0.f;
+
+	float pct = static_cast<float>(ActiveProducers.Num()) / static_cast<float>(UnlockedProducers);
+	return pct >= 0.999f ? 1.0f : pct;
+}
+
+// Buffs come from the session influence grid, kept current as units place, move and clear.
+// A full ClearBuffs and ApplyBuffs pass over every unit resolves to the same buff sets.
+void AMineGridUnit::ApplyBuffs()
+{
+	SyncBuffsAt(GetContext().SessionManager, BuffCoords);
+}
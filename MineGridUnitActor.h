@@ -4,11 +4,18 @@
 #include "CoreMinimal.h"
 
 #include "GridUnitActor.h"
+#include "MineCellStore.h"
+#include "MineCurrency.h"
 #include "MineEnums.h"
+#include "MineGeneration.h"
+#include "MineRotationSolver.h"
 #include "MineshaftCell.h"
+#include "MineTraversal.h"
 
 #include "MineGridUnit.generated.h"
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FYieldChangedDelegate, AMineGridUnit*, Unit);
+
 
 USTRUCT(BlueprintType)
 struct FMineRow
@@ -23,6 +30,19 @@ struct FMineRow
 };
 
 
+// Yield tick at which a producer's CurrentYield next changes, either a partial last draw or running dry
+struct FMineDepletionEvent
+{
+	int32 Tick = 0;
+	int32 Cell = INDEX_NONE;
+
+	bool operator<(const FMineDepletionEvent& other) const
+	{
+		return Tick != other.Tick ? Tick < other.Tick : Cell < other.Cell;
+	}
+};
+
+
 UCLASS()
 class MINESHAFT3_API AMineGridUnit : public AGridUnitActor
 {
@@ -30,27 +50,50 @@ class MINESHAFT3_API AMineGridUnit : public AGridUnitActor
 
 public:
 	virtual void Setup(const FUnitTemplate& unitTemplate) override;
-	virtual void DoYield() override;
+
+	// Setup for many mines at once, generation runs across worker threads. Not for converters.
+	static void SetupBatch(TArrayView<AMineGridUnit* const> units, TArrayView<const FUnitTemplate> unitTemplates);
+	FMineGenParams MakeGenParams(const FUnitTemplate& unitTemplate);
+	void FinishSetup(const FUnitTemplate& unitTemplate, FMineGenResult&& result);
+	virtual void OnYieldTick() override;
 	virtual void Refresh() override;
 
 	UFUNCTION(BlueprintCallable) 
 	UMineshaftCell* GetCell(int32 row, int32 col);
 
+	UFUNCTION(BlueprintCallable) 
+	TArray<UMineshaftCell*> GetActiveProducerCells();
+
 	UFUNCTION(BlueprintCallable) 
 	void ClearCellWalls(int32 row, int32 col);
 
-	void SwapCellProperties(UMineshaftCell* a, UMineshaftCell* b, UMineshaftCell* buffer);
+	void BindCellViews();
+	void SwapCellProperties(int32 a, int32 b);
 	
 	UFUNCTION(BlueprintCallable) 
 	ECellOrientation GetOrientation(UMineshaftCell* from, UMineshaftCell* to);
+	ECellOrientation GetOrientation(int32 from, int32 to) const;
 	
-	void CalculateDistanceToExit(UMineshaftCell* c, TSet<UMineshaftCell*>& vst, int32 distance);
-	void SetShortestPathToExit(UMineshaftCell* cell, UMineshaftCell* prev, ECurrency currency = ECurrency::Stone);
+	void CalculateDistanceToExit(const TArray<int32>& exitRepos, TArray<int32>& order);
+	void BuildProductionChains(const TArray<int32>& order);
 
-	ECellOrientation RotateCellCW(UMineshaftCell* cell, bool calcYield = true);
-	ECellOrientation RotateCellCCW(UMineshaftCell* cell, bool calcYield = true);
+	ECellOrientation RotateCellIndexCW(int32 cell, bool calcYield = true);
+	ECellOrientation RotateCellIndexCCW(int32 cell, bool calcYield = true);
 	UFUNCTION(BlueprintCallable) ECellOrientation RotateCellCW(int32 row, int32 col);
 	UFUNCTION(BlueprintCallable) ECellOrientation RotateCellCCW(int32 row, int32 col);
+
+	// Rotations connecting the most producers across the unlocked rows. Leaves the mine as is.
+	void SolveCellRotations(FMineRotationSolution& solution, int32 seed = 0) const;
+
+	// Cached per layout, only solves again after a rotation, unlock, swap or producer running dry
+	const FMineRotationSolution& GetSolvedRotations() const;
+	uint32 GetRotationLayoutHash() const;
+
+	// Best the search found, not a proven maximum unless IsRotationSolutionOptimal
+	UFUNCTION(BlueprintCallable) int32 GetBestFoundConnectedProducers() const;
+	UFUNCTION(BlueprintCallable) int32 GetConnectedProducersUpperBound() const;
+	UFUNCTION(BlueprintCallable) bool IsRotationSolutionOptimal() const;
+	UFUNCTION(BlueprintCallable) void ApplySolvedRotations();
 	
 	UFUNCTION(BlueprintCallable) int32 GetUnlockLevel();
 	UFUNCTION(BlueprintCallable) bool CanUnlock();
@@ -60,23 +103,57 @@ public:
 	UFUNCTION(BlueprintCallable) bool IsFirstReveal();
 	UFUNCTION(BlueprintCallable) bool IsFullyUnlocked();
 	UFUNCTION(BlueprintCallable) void CalculateYield();
+	void CalculateYieldForCell(int32 cell);
+	void RecalculateComponents(TArrayView<const int32> touched);
+	void LinkCell(int32 cell);
+	void EvaluateComponent(int32 repo);
+	void UpdateProducerYields();
+
+	// Draw CurrentYield from every active producer's bank, recompute only where the queue says yields change
+	void DrainBanks(int32 ticks = 1);
+	int32 PredictDepletionTick(int32 cell) const;
+	void RebuildDepletionQueue();
+	void RestoreSavedBanks();
+
+	// Offline progress. Applies N ticks of bank draw and returns the yield they pay, without touching the wallet.
+	// Yield is constant between depletion events so this steps event to event rather than tick by tick.
+	virtual FCurrencyVector FastForward(int32 ticks);
+
+	// Ticks the current yield holds for, MAX_int32 if nothing is depleting
+	int32 GetTicksToNextYieldChange() const;
+	void CrossCheckYield();
 
-	virtual void SumYieldAmount(TMap<ECurrency, float>& totals) override;
+	virtual void SumYieldAmount(FCurrencyVector& totals) override;
 
-	UFUNCTION(BlueprintCallable) virtual void GetTotalYieldByRef(TMap<ECurrency, float>& total);
+	virtual void GetTotalYieldVectorByRef(FCurrencyVector& total);
+
+	// Blueprint entry point kept for existing graphs, adds onto total like GetTotalYieldVectorByRef
+	UFUNCTION(BlueprintCallable) void GetTotalYieldByRef(TMap<ECurrency, float>& total);
+
+	// Cached GetTotalYieldVectorByRef for UI polling. Dirty on yield recalculation, buff, tech and bank changes.
+	const FCurrencyVector& GetCachedYield();
+	void InvalidateYield();
+
+	// Converters read the wallet, their yield can change without any event on the unit
+	virtual bool IsYieldCacheable() const { return true; }
+
+	// Builds a map on every call. Widgets polling each frame should read GetYieldAmount instead.
 	UFUNCTION(BlueprintCallable) TMap<ECurrency, float> GetTotalYield();
+
+	// Copy of the cached yield, read it with UCurrencyVectorLibrary::GetCurrencyAmount
+	UFUNCTION(BlueprintCallable) FCurrencyVector GetTotalYieldVector();
+
+	// One currency of the cached yield, no allocation
+	UFUNCTION(BlueprintPure) float GetYieldAmount(ECurrency currency);
+	UFUNCTION(BlueprintPure) bool HasYieldCurrency(ECurrency currency);
 	UFUNCTION(BlueprintCallable) bool HasYield();
 	UFUNCTION(BlueprintCallable) float GetActiveProducerPercent();
 
 	virtual void ApplyBuffs() override;
 
-	static const TMap<FName, void(AMineGridUnit::*)(TMap<ECurrency, float>&)> S_Buffs;
-	
-	void Buff_StoneOutput(TMap<ECurrency, float>& total);
-	void Buff_CopperOutput(TMap<ECurrency, float>& total);
-	void Buff_IronOutput(TMap<ECurrency, float>& total);
-	void Buff_GoldOutput(TMap<ECurrency, float>& total);
-	void Buff_GoldMultiplier(TMap<ECurrency, float>& total);
+	virtual void CompileBuffs() override;
+
+	static const TMap<FName, TArray<FMineBuffOp>> S_Buffs;
 
 	UPROPERTY(SaveGame, EditAnywhere) 
 	float BankInitialMin = 200.f;
@@ -117,9 +194,42 @@ public:
 	UPROPERTY(SaveGame, EditAnywhere) 
 	bool RotateTracksOnSetup = true;
 
+	UPROPERTY(SaveGame, EditAnywhere) 
+	EMineMazeAlgorithm MazeAlgorithm = EMineMazeAlgorithm::BinaryTree;
+
 	UPROPERTY(SaveGame, EditAnywhere, BlueprintReadWrite) 
 	bool EnableTransactions = false;
 
+	// Rotations only re-evaluate the components touching the rotated cell
+	UPROPERTY(EditAnywhere) 
+	bool IncrementalYield = true;
+
+	// Debug: run the full CalculateYield after every incremental update and assert the results match
+	UPROPERTY(EditAnywhere) 
+	bool CrossCheckIncrementalYield = false;
+
+	// Producers draw their yield from Bank each tick and stop producing when it runs dry.
+	// Class tuning, not saved, so default changes reach existing mines.
+	UPROPERTY(EditAnywhere) 
+	bool DepleteBanks = true;
+
+	// Bank rules this mine was generated under. Mines saved before banks depleted load as 0 and keep
+	// their banks full, FinishSetup stamps new mines with DepletingBankModel.
+	UPROPERTY(SaveGame) 
+	int32 BankModel = 0;
+
+	static constexpr int32 DepletingBankModel = 1;
+
+	bool IsDepletingBanks() const { return DepleteBanks && BankModel >= DepletingBankModel; }
+
+	// Yield ticks drained so far, the clock for DepletionQueue
+	UPROPERTY(SaveGame, BlueprintReadOnly) 
+	int32 YieldTicks = 0;
+
+	// Bank of every cell as of the last drain. Refresh restores it so loaded banks match YieldTicks.
+	UPROPERTY(SaveGame) 
+	TArray<float> SavedBanks;
+
 	UPROPERTY(SaveGame, BlueprintReadWrite) 
 	int32 TotalProducers = 0;
 
@@ -129,6 +239,30 @@ public:
 	UPROPERTY(SaveGame, BlueprintReadWrite) 
 	TArray<FMineRow> Rows;
 	
-	UPROPERTY(BlueprintReadWrite) 
-	TSet<UMineshaftCell*> ActiveProducers; 
+	// Per-cell data for every row. Rows[].Cells are views into this store.
+	FMineCellStore CellStore;
+
+	// Cell indices into CellStore
+	TArray<int32> ActiveProducers; 
+
+	// Min-heap of active producers by the tick their yield next changes. Rebuilt with ActiveProducers.
+	TArray<FMineDepletionEvent> DepletionQueue;
+
+	// Buffs flattened into lane operations, rebuilt whenever Buffs changes
+	TArray<FMineBuffOp> CompiledBuffs;
+
+	UPROPERTY(BlueprintAssignable)
+	FYieldChangedDelegate YieldChangedDelegate;
+
+	mutable FMineRotationSolution CachedRotationSolution;
+	mutable uint32 CachedRotationLayout = 0;
+	mutable bool bRotationSolutionCached = false;
+
+	FCurrencyVector CachedYield;
+	uint32 CachedTechVersion = 0;
+	bool bYieldDirty = true;
+
+	// Search scratch, reused across yield calculations. PathTraversal is for queries nested inside a component walk.
+	FMineTraversal Traversal;
+	FMineTraversal PathTraversal;
 };
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "MineIntentOverlay.h"
+#include "GridCellActor.h"
+#include "SessionManager.h"
+
+
+void FMineIntentOverlay::Set(const AGridUnitActor* source, TArrayView<const FCoordinates> coords)
+{
+	RemoveFootprint(source);
+
+	auto& footprint = Sources.Add(source);
+	footprint.Append(coords.GetData(), coords.Num());
+	for(const FCoordinates& coord : coords)
+	{
+		FIntPoint point(coord.Col, coord.Row);
+		Counts.FindOrAdd(point)++;
+		Dirty.Add(point);
+	}
+}
+
+void FMineIntentOverlay::Remove(const AGridUnitActor* source)
+{
+	RemoveFootprint(source);
+}
+
+void FMineIntentOverlay::RemoveFootprint(const AGridUnitActor* source)
+{
+	TArray<FCoordinates, TInlineAllocator<16>> footprint;
+	if(!Sources.RemoveAndCopyValue(source, footprint))
+		return;
+
+	for(const FCoordinates& coord : footprint)
+	{
+		FIntPoint point(coord.Col, coord.Row);
+		int32& count = Counts.FindChecked(point);
+		check(count > 0);
+		if(--count == 0)
+			Counts.Remove(point);
+		Dirty.Add(point);
+	}
+}
+
+int32 FMineIntentOverlay::GetCount(int32 row, int32 col) const
+{
+	const int32* count = Counts.Find(FIntPoint(col, row));
+	return count ? *count : 0;
+}
+
+// Cells only hear about transitions between targeted and untargeted, a count going 2 to 1 pushes nothing
+void FMineIntentOverlay::Flush(USessionManager* sm)
+{
+	for(const FIntPoint& point : Dirty)
+	{
+		bool targeted = Counts.Contains(point);
+		if(targeted == Shown.Contains(point)) continue;
+
+		AGridCellActor* cell = sm->GetGridCell(point.Y, point.X);
+		if(targeted)
+		{
+			if(cell)
+				cell->AddIntent(EUnitIntent::Attack);
+			Shown.Add(point);
+		}
+		else
+		{
+			if(cell)
+				cell->RemoveIntent(EUnitIntent::Attack);
+			Shown.Remove(point);
+		}
+	}
+	Dirty.Reset();
+}
+
+void FMineIntentOverlay::Reset(USessionManager* sm)
+{
+	if(sm)
+	{
+		for(const FIntPoint& point : Shown)
+		{
+			if(AGridCellActor* cell = sm->GetGridCell(point.Y, point.X))
+				cell->RemoveIntent(EUnitIntent::Attack);
+		}
+	}
+
+
+	Counts.Reset();
+	Sources.Reset();
+	Dirty.Reset();
+	Shown.Reset();
+}
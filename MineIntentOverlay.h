@@ -0,0 +1,40 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "UnitTemplateDataTable.h"
+
+class AGridUnitActor;
+class USessionManager;
+
+
+// Attack intent reference counts per grid cell. Units publish their attack footprint only when
+// CurrentAttacks changes, and cell actors hear about changed cells once per flush. The overlay owns
+// the cell markers, nothing else adds or removes attack intents on cells.
+struct FMineIntentOverlay
+{
+	// Replaces any footprint this source already had
+	void Set(const AGridUnitActor* source, TArrayView<const FCoordinates> coords);
+	void Remove(const AGridUnitActor* source);
+
+	int32 GetCount(int32 row, int32 col) const;
+	bool IsDirty() const { return Dirty.Num() > 0; }
+
+	// AddIntent on changed cells that became targeted, RemoveIntent on those that no longer are
+	void Flush(USessionManager* sm);
+
+	// Clears the markers this overlay put on cells before forgetting them. sm may be null once the grid is gone.
+	void Reset(USessionManager* sm);
+
+private:
+	void RemoveFootprint(const AGridUnitActor* source);
+
+	TMap<FIntPoint, int32> Counts;
+	TMap<const AGridUnitActor*, TArray<FCoordinates, TInlineAllocator<16>>> Sources;
+
+	// Cells whose count changed since the last flush
+	TSet<FIntPoint> Dirty;
+
+	// Cells the last flushes marked with an attack intent
+	TSet<FIntPoint> Shown;
+};
@@ -0,0 +1,197 @@
+#include "MineMazeGenerators.h"
+
+
+namespace
+{
+	void LinkCells(FMineCellStore& store, int32 cell, int32 dir)
+	{
+		int32 next = store.Neighbor(cell, dir);
+		check(next != INDEX_NONE);
+		store.MazeLinks[cell] |= MineDir::Bit(dir);
+		store.MazeLinks[next] |= MineDir::Bit(MineDir::Opposite(dir));
+	}
+
+	// Uniform pick among the set bits of a non-empty direction mask
+	int32 RandomDir(uint8 mask, FRandomStream& random)
+	{
+		check(mask != 0);
+		int32 pick = random.RandHelper(MineCellTables::CountBits(mask));
+		for(int32 dir = 0; dir < MineDir::Num; ++dir)
+		{
+			if((mask & MineDir::Bit(dir)) && pick-- == 0)
+				return dir;
+		}
+		return INDEX_NONE;
+	}
+
+	// Neighbors in rows 0..maxRow. Carving row by row keeps every unlock prefix connected on its own.
+	uint8 DirsWithin(const FMineCellStore& store, int32 cell, int32 maxRow)
+	{
+		uint8 dirs = store.NeighborMask[cell];
+		if(store.RowOf(cell) >= maxRow)
+			dirs &= ~MineDir::Bit(MineDir::South);
+		return dirs;
+	}
+
+	// Directions toward neighbors in rows 0..maxRow that haven't been carved into yet
+	uint8 UnvisitedDirs(const FMineCellStore& store, const TBitArray<>& visited, int32 cell, int32 maxRow)
+	{
+		uint8 dirs = 0;
+		uint8 within = DirsWithin(store, cell, maxRow);
+		for(int32 dir = 0; dir < MineDir::Num; ++dir)
+		{
+			if((within & MineDir::Bit(dir)) && !visited[store.Neighbor(cell, dir)])
+				dirs |= MineDir::Bit(dir);
+		}
+		return dirs;
+	}
+
+	// Cells a row grows from. Row 0 starts at one random cell, later rows from the whole row above in random order.
+	void SeedRow(const FMineCellStore& store, int32 row, FRandomStream& random, TBitArray<>& visited, TArray<int32>& seeds)
+	{
+		if(row == 0)
+		{
+			int32 start = store.Index(0, random.RandHelper(store.Columns));
+			visited[start] = true;
+			seeds.Add(start);
+			return;
+		}
+
+		int32 first = seeds.Num();
+		for(int32 col = 0; col < store.Columns; ++col)
+			seeds.Add(store.Index(row - 1, col));
+
+		for(int32 n = first; n < seeds.Num(); ++n)
+			Swap(seeds[n], seeds[n + random.RandHelper(seeds.Num() - n)]);
+	}
+}
+
+
+void CarveBinaryTree(FMineCellStore& store, FRandomStream& random)
+{
+	const int32 columns = store.Columns;
+	for(int32 r = store.NumRows-1; r >= 0; --r)
+	{
+		for(int32 c = 0; c < columns; ++c)
+		{
+			int32 current = store.Index(r, c);
+
+			// Always carve right on the final row
+			if(r == 0)
+			{
+				if(c < columns-1)
+					LinkCells(store, current, MineDir::East);
+				continue;
+			}
+
+			if( (c == 0) ||
+				((c < columns-1) && random.FRand() < 0.5f) ) 
+			{
+				// carve right
+				LinkCells(store, current, MineDir::East);
+			}
+			else
+			{
+				// carve up on final column
+				LinkCells(store, current, MineDir::North);
+			}
+		}
+	}
+}
+
+// The walk only remembers the last way out of each cell, so retracing it skips every loop.
+// Each row's walks stay in rows 0..row and end on the rows above, uniform among trees with connected row prefixes.
+void CarveWilson(FMineCellStore& store, FRandomStream& random)
+{
+	TBitArray<> inTree(false, store.Num());
+	TArray<uint8> exitDir;
+	exitDir.SetNumZeroed(store.Num());
+
+	inTree[store.Index(0, random.RandHelper(store.Columns))] = true;
+	for(int32 start = 0; start < store.Num(); ++start)
+	{
+		int32 maxRow = store.RowOf(start);
+		int32 cell = start;
+		while(!inTree[cell])
+		{
+			exitDir[cell] = static_cast<uint8>(RandomDir(DirsWithin(store, cell, maxRow), random));
+			cell = store.Neighbor(cell, exitDir[cell]);
+		}
+
+		for(cell = start; !inTree[cell]; cell = store.Neighbor(cell, exitDir[cell]))
+		{
+			inTree[cell] = true;
+			LinkCells(store, cell, exitDir[cell]);
+		}
+	}
+}
+
+// Depth first within each row. Rows can't reach below themselves, so each one becomes a single winding run.
+void CarveRecursiveBacktracker(FMineCellStore& store, FRandomStream& random)
+{
+	TBitArray<> visited(false, store.Num());
+	TArray<int32> stack;
+	stack.Reserve(store.Num());
+
+	for(int32 row = 0; row < store.NumRows; ++row)
+	{
+		SeedRow(store, row, random, visited, stack);
+		while(stack.Num() > 0)
+		{
+			int32 cell = stack.Last();
+			uint8 dirs = UnvisitedDirs(store, visited, cell, row);
+			if(dirs == 0)
+			{
+				stack.Pop(false);
+				continue;
+			}
+
+			int32 dir = RandomDir(dirs, random);
+			int32 next = store.Neighbor(cell, dir);
+			LinkCells(store, cell, dir);
+			visited[next] = true;
+			stack.Add(next);
+		}
+	}
+}
+
+// Removal swaps in the last cell, so "newest" drifts a little once cells start closing. Layouts stay the same family.
+void CarveGrowingTree(FMineCellStore& store, FRandomStream& random)
+{
+	TBitArray<> visited(false, store.Num());
+	TArray<int32> open;
+	open.Reserve(store.Num());
+
+	for(int32 row = 0; row < store.NumRows; ++row)
+	{
+		SeedRow(store, row, random, visited, open);
+		while(open.Num() > 0)
+		{
+			int32 slot = random.FRand() < 0.5f ? open.Num()-1 : random.RandHelper(open.Num());
+			int32 cell = open[slot];
+			uint8 dirs = UnvisitedDirs(store, visited, cell, row);
+			if(dirs == 0)
+			{
+				open.RemoveAtSwap(slot, 1, false);
+				continue;
+			}
+
+			int32 dir = RandomDir(dirs, random);
+			int32 next = store.Neighbor(cell, dir);
+			LinkCells(store, cell, dir);
+			visited[next] = true;
+			open.Add(next);
+		}
+	}
+}
+
+FMineMazeCarveFunc GetMazeCarver(EMineMazeAlgorithm algorithm)
+{
+	switch(algorithm)
+	{
+	case EMineMazeAlgorithm::Wilson:				return &CarveWilson;
+	case EMineMazeAlgorithm::RecursiveBacktracker:	return &CarveRecursiveBacktracker;
+	case EMineMazeAlgorithm::GrowingTree:			return &CarveGrowingTree;
+	default:										return &CarveBinaryTree;
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "MineCellStore.h"
+
+#include "MineMazeGenerators.generated.h"
+
+
+UENUM(BlueprintType)
+enum class EMineMazeAlgorithm : uint8
+{
+	// Right or up, always right on the top row. Fast, biased toward long corridors and never carves a cross.
+	BinaryTree,
+
+	// Loop-erased random walks. Every tree with connected row prefixes is equally likely.
+	Wilson,
+
+	// Depth first with an explicit stack. Each row is one long run with a single link up.
+	RecursiveBacktracker,
+
+	// Expands from the newest or a random open cell, half and half. Rows split into several runs.
+	GrowingTree,
+};
+
+
+// Carves a spanning tree into store.MazeLinks, every cell reachable from every other. Rows 0..k are connected
+// without leaving those rows for every k, so each unlock has a solution that doesn't route through locked rows.
+// Rows are carved top down, each growing only from the rows above it.
+// Expects a freshly initialized store and draws everything from random.
+using FMineMazeCarveFunc = void(*)(FMineCellStore& store, FRandomStream& random);
+
+void CarveBinaryTree(FMineCellStore& store, FRandomStream& random);
+void CarveWilson(FMineCellStore& store, FRandomStream& random);
+void CarveRecursiveBacktracker(FMineCellStore& store, FRandomStream& random);
+void CarveGrowingTree(FMineCellStore& store, FRandomStream& random);
+
+FMineMazeCarveFunc GetMazeCarver(EMineMazeAlgorithm algorithm);
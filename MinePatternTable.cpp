@@ -0,0 +1,102 @@
+#include "MinePatternTable.h"
+#include "GridCellActor.h"
+#include "SessionManager.h"
+
+
+const FMinePatternTable::FEntry& FMinePatternTable::FindOrAdd(USessionManager* sm, const AGridCellActor* origin, TArrayView<const FBuffPattern> patterns)
+{
+	check(origin);
+	uint32 hash = HashCombine(HashPatterns(patterns), GetTypeHash(origin));
+
+	for(auto it = Lookup.CreateConstKeyIterator(hash); it; ++it)
+	{
+		FEntry& entry = Entries[it.Value()];
+		if(entry.Origin == origin && SamePatterns(entry.Patterns, patterns))
+		{
+			entry.LastUsed = ++UseCounter;
+			return entry;
+		}
+	}
+
+	if(Entries.Num() >= MaxEntries)
+		Evict();
+
+	Scratch.Reset();
+	for(const FBuffPattern& pattern : patterns)
+		sm->GetPatternCoordinates(origin->Row, origin->Col, Scratch, pattern);
+
+	FEntry& entry = Entries.AddDefaulted_GetRef();
+	entry.Patterns = TArray<FBuffPattern>(patterns.GetData(), patterns.Num());
+	entry.Origin = origin;
+	entry.Start = Coords.Num();
+	entry.LastUsed = ++UseCounter;
+
+	// Overlapping patterns list a cell once
+	Seen.Reset();
+	for(const FCoordinates& coord : Scratch)
+	{
+		bool seen = false;
+		Seen.Add(FIntPoint(coord.Col, coord.Row), &seen);
+		if(!seen)
+			Coords.Add(coord);
+	}
+	entry.Num = Coords.Num() - entry.Start;
+
+	Lookup.Add(hash, Entries.Num()-1);
+	return entry;
+}
+
+uint32 FMinePatternTable::HashPatterns(TArrayView<const FBuffPattern> patterns)
+{
+	UScriptStruct* type = FBuffPattern::StaticStruct();
+
+	uint32 hash = GetTypeHash(patterns.Num());
+	for(const FBuffPattern& pattern : patterns)
+		hash = HashCombine(hash, type->GetStructTypeHash(&pattern));
+	return hash;
+}
+
+bool FMinePatternTable::SamePatterns(TArrayView<const FBuffPattern> a, TArrayView<const FBuffPattern> b)
+{
+	if(a.Num() != b.Num()) return false;
+
+	UScriptStruct* type = FBuffPattern::StaticStruct();
+	for(int32 n = 0; n < a.Num(); ++n)
+	{
+		if(!type->CompareScriptStruct(&a[n], &b[n], PPF_None))
+			return false;
+	}
+	return true;
+}
+
+void FMinePatternTable::Evict()
+{
+	// Cells from a torn down grid go first, then the least recently used
+	Entries.RemoveAll([](const FEntry& entry) { return !entry.Origin.IsValid(); });
+	if(Entries.Num() > MaxEntries / 2)
+	{
+		Entries.Sort([](const FEntry& a, const FEntry& b) { return a.LastUsed > b.LastUsed; });
+		Entries.SetNum(MaxEntries / 2);
+	}
+
+	TArray<FCoordinates> coords;
+	Lookup.Reset();
+	for(int32 idx = 0; idx < Entries.Num(); ++idx)
+	{
+		FEntry& entry = Entries[idx];
+		int32 start = coords.Num();
+		coords.Append(Coords.GetData() + entry.Start, entry.Num);
+		entry.Start = start;
+
+		Lookup.Add(HashCombine(HashPatterns(entry.Patterns), GetTypeHash(entry.Origin.Get())), idx);
+	}
+	Coords = MoveTemp(coords);
+}
+
+void FMinePatternTable::Reset()
+{
+	Lookup.Reset();
+	Entries.Reset();
+	Coords.Reset();
+	UseCounter = 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "UnitTemplateDataTable.h"
+
+class AGridCellActor;
+class USessionManager;
+
+
+// Buff and attack pattern coordinates per pattern set and origin cell. Each origin is expanded once
+// through USessionManager::GetPatternCoordinates, clipped and deduplicated, then shared by every unit.
+// Entries are keyed by the pattern contents, so templates sharing a UnitKey or a pattern list never collide.
+// Origins are keyed by cell actor, so a rebuilt grid never hits coordinates clipped against the old one.
+// GetPatternCoordinates clips against the live grid, so offsets can't be shared between origins.
+struct FMinePatternTable
+{
+	// Entries kept before the least recently used are evicted
+	static constexpr int32 MaxEntries = 1024;
+
+	// Appends the coordinates of patterns around origin to out
+	template<typename AllocatorType>
+	void Get(USessionManager* sm, const AGridCellActor* origin, TArrayView<const FBuffPattern> patterns, TArray<FCoordinates, AllocatorType>& out)
+	{
+		const FEntry& entry = FindOrAdd(sm, origin, patterns);
+		out.Append(Coords.GetData() + entry.Start, entry.Num);
+	}
+
+	// Drops every entry, e.g. a new session
+	void Reset();
+
+private:
+	struct FEntry
+	{
+		TArray<FBuffPattern> Patterns;
+		TWeakObjectPtr<const AGridCellActor> Origin;
+		int32 Start = 0;
+		int32 Num = 0;
+		uint32 LastUsed = 0;
+	};
+
+	// Valid until the next FindOrAdd
+	const FEntry& FindOrAdd(USessionManager* sm, const AGridCellActor* origin, TArrayView<const FBuffPattern> patterns);
+
+	static uint32 HashPatterns(TArrayView<const FBuffPattern> patterns);
+	static bool SamePatterns(TArrayView<const FBuffPattern> a, TArrayView<const FBuffPattern> b);
+
+	// Keeps the most recently used half of the entries and compacts Coords
+	void Evict();
+
+	TMultiMap<uint32, int32> Lookup;
+	TArray<FEntry> Entries;
+	TArray<FCoordinates> Coords;
+	TArray<FCoordinates> Scratch;
+	TSet<FIntPoint> Seen;
+	uint32 UseCounter = 0;
+};
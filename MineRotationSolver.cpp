@@ -0,0 +1,381 @@
+#include "MineRotationSolver.h"
+#include "Async/ParallelFor.h"
+#include "MineTraversal.h"
+
+
+namespace
+{
+	// Distinct rotations left for one cell
+	struct FCellOptions
+	{
+		uint8 Masks[4] = {};
+		uint8 Turns[4] = {};
+		int32 Num = 0;
+	};
+
+	struct FSolveContext
+	{
+		const FMineCellStore& Store;
+		const TBitArray<>& Active;
+		TArray<FCellOptions> Options;
+
+		bool IsActive(int32 cell) const { return Active.Num() == 0 || Active[cell]; }
+		bool IsTarget(int32 cell) const { return Store.IsProducer(cell) && Store.Bank[cell] > 0.f; }
+	};
+
+	// Same linking rule as AMineGridUnit::LinkCell, both sides must be open
+	bool IsLinked(const FSolveContext& ctx, const TArray<uint8>& masks, int32 cell, uint8 mask, int32 dir)
+	{
+		if((mask & MineDir::Bit(dir)) == 0) return false;
+
+		int32 neighbor = ctx.Store.Neighbor(cell, dir);
+		return neighbor != INDEX_NONE && ctx.IsActive(neighbor) && (masks[neighbor] & MineDir::Bit(MineDir::Opposite(dir)));
+	}
+
+	uint8 LinkedDirs(const FSolveContext& ctx, const TArray<uint8>& masks, int32 cell, uint8 mask)
+	{
+		uint8 linked = 0;
+		for(int32 dir = 0; dir < MineDir::Num; ++dir)
+		{
+			if(IsLinked(ctx, masks, cell, mask, dir))
+				linked |= MineDir::Bit(dir);
+		}
+		return linked;
+	}
+
+	// Cells linked to an active repo, and how many of them are producers
+	struct FReach
+	{
+		TBitArray<> Reached;
+		int32 Connected = 0;
+	};
+
+	int32 CountConnected(const FSolveContext& ctx, const TArray<uint8>& masks, FMineTraversal& traversal, FReach& reach)
+	{
+		const FMineCellStore& store = ctx.Store;
+		reach.Reached.Init(false, store.Num());
+		traversal.Begin(store.Num());
+		for(int32 cell = 0; cell < store.Num(); ++cell)
+		{
+			if(store.IsRepo(cell) && ctx.IsActive(cell))
+				traversal.Visit(cell);
+		}
+
+		int32 count = 0;
+		while(traversal.HasNext())
+		{
+			int32 c = traversal.Next();
+			reach.Reached[c] = true;
+			if(ctx.IsTarget(c))
+				count++;
+
+			for(int32 dir = 0; dir < MineDir::Num; ++dir)
+			{
+				if(IsLinked(ctx, masks, c, masks[c], dir))
+					traversal.Visit(store.Neighbor(c, dir));
+			}
+		}
+		reach.Connected = count;
+		return count;
+	}
+
+	// Adding links only ever reaches more cells, so the reach grows from the new links without a recount.
+	// Marked cells are appended to grown so a rejected move can be undone.
+	int32 Grow(const FSolveContext& ctx, const TArray<uint8>& masks, FReach& reach, TArray<int32>& stack, TArray<int32>& grown)
+	{
+		int32 gained = 0;
+		while(stack.Num() > 0)
+		{
+			int32 c = stack.Pop(false);
+			if(reach.Reached[c]) continue;
+
+			reach.Reached[c] = true;
+			grown.Add(c);
+			if(ctx.IsTarget(c))
+				gained++;
+
+			for(int32 dir = 0; dir < MineDir::Num; ++dir)
+			{
+				if(!IsLinked(ctx, masks, c, masks[c], dir)) continue;
+
+				int32 neighbor = ctx.Store.Neighbor(c, dir);
+				if(!reach.Reached[neighbor])
+					stack.Add(neighbor);
+			}
+		}
+		reach.Connected += gained;
+		return gained;
+	}
+
+	// Drop rotations whose useful openings are covered by another rotation. More links never disconnect
+	// anything, so the dropped rotation can't beat the one covering it. Repeat until nothing changes.
+	void PruneOptions(FSolveContext& ctx, TArray<uint8>& canOpen)
+	{
+		const FMineCellStore& store = ctx.Store;
+		bool changed = true;
+		while(changed)
+		{
+			changed = false;
+			for(int32 cell = 0; cell < store.Num(); ++cell)
+			{
+				if(!ctx.IsActive(cell)) continue;
+
+				uint8 useful = 0;
+				for(int32 dir = 0; dir < MineDir::Num; ++dir)
+				{
+					int32 neighbor = store.Neighbor(cell, dir);
+					if(neighbor != INDEX_NONE && ctx.IsActive(neighbor) && (canOpen[neighbor] & MineDir::Bit(MineDir::Opposite(dir))))
+						useful |= MineDir::Bit(dir);
+				}
+
+				FCellOptions& options = ctx.Options[cell];
+				FCellOptions kept;
+				for(int32 i = 0; i < options.Num; ++i)
+				{
+					uint8 mine = options.Masks[i] & useful;
+					bool covered = false;
+					for(int32 j = 0; j < options.Num && !covered; ++j)
+					{
+						uint8 other = options.Masks[j] & useful;
+						covered = j != i && (other & mine) == mine && (other != mine || j < i);
+					}
+
+					if(!covered)
+					{
+						kept.Masks[kept.Num] = options.Masks[i];
+						kept.Turns[kept.Num] = options.Turns[i];
+						kept.Num++;
+					}
+				}
+
+				uint8 open = 0;
+				for(int32 i = 0; i < kept.Num; ++i)
+					open |= kept.Masks[i] & useful;
+
+				if(kept.Num != options.Num || open != canOpen[cell])
+				{
+					options = kept;
+					canOpen[cell] = open;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	// Producers reachable over every link some pair of rotations could make. Dead ends can be reached but not passed.
+	int32 CountReachable(const FSolveContext& ctx, const TArray<uint8>& canOpen, TBitArray<>& reachable)
+	{
+		const FMineCellStore& store = ctx.Store;
+		reachable.Init(false, store.Num());
+
+		FMineTraversal traversal;
+		traversal.Begin(store.Num());
+		for(int32 cell = 0; cell < store.Num(); ++cell)
+		{
+			if(store.IsRepo(cell) && ctx.IsActive(cell))
+				traversal.Visit(cell);
+		}
+
+		int32 count = 0;
+		while(traversal.HasNext())
+		{
+			int32 c = traversal.Next();
+			reachable[c] = true;
+			if(ctx.IsTarget(c))
+				count++;
+
+			bool passable = store.IsRepo(c);
+			for(int32 i = 0; i < ctx.Options[c].Num && !passable; ++i)
+				passable = MineCellTables::CountBits(ctx.Options[c].Masks[i] & canOpen[c]) > 1;
+			if(!passable) continue;
+
+			for(int32 dir = 0; dir < MineDir::Num; ++dir)
+			{
+				if((canOpen[c] & MineDir::Bit(dir)) == 0) continue;
+
+				int32 neighbor = store.Neighbor(c, dir);
+				if(neighbor != INDEX_NONE && (canOpen[neighbor] & MineDir::Bit(MineDir::Opposite(dir))))
+					traversal.Visit(neighbor);
+			}
+		}
+		return count;
+	}
+
+	struct FSearchResult
+	{
+		TArray<uint8> Choice;
+		int32 Connected = -1;
+	};
+
+	// Hill climb over the pruned options. Moves that only add links, or that touch a cell no repo reaches yet,
+	// grow the current reach in place. Only a move cutting a link of a reached cell needs a full recount.
+	void Search(const FSolveContext& ctx, const TArray<int32>& turnable, int32 upperBound, int32 maxSweeps, int32 restart, int32 seed, FSearchResult& result)
+	{
+		const FMineCellStore& store = ctx.Store;
+		FRandomStream random(seed + restart);
+		FMineTraversal traversal;
+
+		// First search starts from the current layout, the rest from random rotations. Choices index the
+		// pruned options, so the current layout is the option with no turns. If pruning dropped it, a
+		// rotation covering its useful openings was kept and the first option is as good a start.
+		TArray<uint8> choice;
+		TArray<uint8> masks;
+		choice.SetNumZeroed(store.Num());
+		masks.SetNumUninitialized(store.Num());
+		for(int32 cell = 0; cell < store.Num(); ++cell)
+		{
+			const FCellOptions& options = ctx.Options[cell];
+			if(restart > 0 && options.Num > 1)
+			{
+				choice[cell] = static_cast<uint8>(random.RandHelper(options.Num));
+			}
+			else
+			{
+				for(int32 i = 0; i < options.Num; ++i)
+				{
+					if(options.Turns[i] == 0)
+						choice[cell] = static_cast<uint8>(i);
+				}
+			}
+			masks[cell] = options.Num > 0 ? options.Masks[choice[cell]] : store.WallOrientation[cell];
+		}
+
+		FReach reach;
+		FReach recount;
+		TArray<int32> stack;
+		TArray<int32> grown;
+
+		int32 current = CountConnected(ctx, masks, traversal, reach);
+		result.Choice = choice;
+		result.Connected = current;
+
+		TArray<int32> order = turnable;
+		for(int32 sweep = 0; sweep < maxSweeps && result.Connected < upperBound; ++sweep)
+		{
+			for(int32 n = 0; n < order.Num(); ++n)
+				Swap(order[n], order[n + random.RandHelper(order.Num() - n)]);
+
+			for(int32 cell : order)
+			{
+				const FCellOptions& options = ctx.Options[cell];
+				for(int32 i = 0; i < options.Num; ++i)
+				{
+					uint8 kept = choice[cell];
+					if(i == kept) continue;
+
+					uint8 from = LinkedDirs(ctx, masks, cell, masks[cell]);
+					uint8 to = LinkedDirs(ctx, masks, cell, options.Masks[i]);
+					masks[cell] = options.Masks[i];
+
+					int32 value = current;
+					bool recounted = false;
+					grown.Reset();
+					if(!reach.Reached[cell] || (to & from) == from)
+					{
+						// Links an unreached cell drops never carried anything
+						stack.Reset();
+						for(int32 dir = 0; dir < MineDir::Num; ++dir)
+						{
+							if((to & ~from & MineDir::Bit(dir)) == 0) continue;
+
+							int32 neighbor = store.Neighbor(cell, dir);
+							if(reach.Reached[cell] != reach.Reached[neighbor])
+								stack.Add(reach.Reached[cell] ? neighbor : cell);
+						}
+						value += Grow(ctx, masks, reach, stack, grown);
+					}
+					else
+					{
+						value = CountConnected(ctx, masks, traversal, recount);
+						recounted = true;
+					}
+
+					// Sideways moves let the search drift across plateaus
+					if(value > current || (value == current && random.FRand() < 0.25f))
+					{
+						choice[cell] = static_cast<uint8>(i);
+						current = value;
+						if(recounted)
+							Swap(reach, recount);
+						continue;
+					}
+
+					masks[cell] = options.Masks[kept];
+					for(int32 c : grown)
+						reach.Reached[c] = false;
+					reach.Connected = current;
+				}
+
+				if(current > result.Connected)
+				{
+					result.Choice = choice;
+					result.Connected = current;
+					if(current == upperBound) break;
+				}
+			}
+		}
+	}
+}
+
+void SolveRotations(const FMineCellStore& store, const FMineRotationSolveParams& params, FMineRotationSolution& solution)
+{
+	FSolveContext ctx { store, params.Active };
+
+	ctx.Options.SetNum(store.Num());
+	TArray<uint8> canOpen;
+	canOpen.SetNumZeroed(store.Num());
+	for(int32 cell = 0; cell < store.Num(); ++cell)
+	{
+		FCellOptions& options = ctx.Options[cell];
+		for(int32 turns = 0; turns < 4; ++turns)
+		{
+			uint8 mask = MineCellTables::Rotate(store.WallOrientation[cell], turns);
+			if(MineCellTables::TurnsCW(store.WallOrientation[cell], mask) != turns) continue;
+
+			options.Masks[options.Num] = mask;
+			options.Turns[options.Num] = static_cast<uint8>(turns);
+			options.Num++;
+			canOpen[cell] |= mask;
+		}
+
+		if(!ctx.IsActive(cell))
+		{
+			options.Num = 1;
+			canOpen[cell] = 0;
+		}
+	}
+
+	PruneOptions(ctx, canOpen);
+
+	TBitArray<> reachable;
+	solution.UpperBound = CountReachable(ctx, canOpen, reachable);
+
+	// Only cells that can still turn and that a repo could ever reach are worth searching
+	TArray<int32> turnable;
+	for(int32 cell = 0; cell < store.Num(); ++cell)
+	{
+		if(ctx.Options[cell].Num > 1 && reachable[cell])
+			turnable.Add(cell);
+	}
+
+	int32 restarts = params.Restarts > 0 ? params.Restarts : FMath::Max(1, FPlatformMisc::NumberOfWorkerThreadsToSpawn());
+	TArray<FSearchResult> results;
+	results.SetNum(restarts);
+	ParallelFor(restarts, [&](int32 restart)
+	{
+		Search(ctx, turnable, solution.UpperBound, params.MaxSweeps, restart, params.Seed, results[restart]);
+	});
+
+	// Ties go to the lowest restart so the answer doesn't depend on scheduling
+	int32 best = 0;
+	for(int32 restart = 1; restart < restarts; ++restart)
+	{
+		if(results[restart].Connected > results[best].Connected)
+			best = restart;
+	}
+
+	solution.ConnectedProducers = results[best].Connected;
+	solution.TurnsCW.SetNumUninitialized(store.Num());
+	for(int32 cell = 0; cell < store.Num(); ++cell)
+		solution.TurnsCW[cell] = ctx.Options[cell].Turns[results[best].Choice[cell]];
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "MineCellStore.h"
+
+
+struct FMineRotationSolveParams
+{
+	// Cells that can carry yield, e.g. unlocked rows. Empty means every cell.
+	TBitArray<> Active;
+
+	// Independent searches spread across worker threads. 0 runs one per worker.
+	int32 Restarts = 0;
+
+	// Passes over every turnable cell per search
+	int32 MaxSweeps = 16;
+
+	int32 Seed = 0;
+};
+
+struct FMineRotationSolution
+{
+	// Clockwise turns per cell from its current WallOrientation
+	TArray<uint8> TurnsCW;
+
+	// Producers linked to a repo with these rotations
+	int32 ConnectedProducers = 0;
+
+	// Producers reachable if every cell could face every way it turns at once
+	int32 UpperBound = 0;
+
+	bool IsOptimal() const { return ConnectedProducers == UpperBound; }
+};
+
+
+// Rotations maximizing producers linked to a repo. Rotations that can never open toward a neighbor that can
+// open back are pruned to a fixed point, the rest is a seeded local search that stops at the upper bound.
+// Plain data, safe off the game thread.
+void SolveRotations(const FMineCellStore& store, const FMineRotationSolveParams& params, FMineRotationSolution& solution);
@@ -0,0 +1,35 @@
+#include "MineTechCache.h"
+#include "TechLabUnitActor.h"
+
+
+// Tech is only ever added within a session. Anything that removes or edits tech, or replaces the list
+// in place like a session load, must call Invalidate().
+void FMineTechCache::Sync(const TArray<UTechNode*>& activeTech)
+{
+	if(!bDirty && Source == &activeTech && TechNum == activeTech.Num()) return;
+
+	Modifiers.Reset();
+	for(UTechNode* tech : activeTech)
+	{
+		FModifier& modifier = Modifiers.FindOrAdd({ tech->UnitKey, tech->Trait });
+		modifier.Value += tech->TraitValue;
+		modifier.Count++;
+	}
+
+	Source = &activeTech;
+	TechNum = activeTech.Num();
+	bDirty = false;
+	Version++;
+}
+
+float FMineTechCache::GetValue(FName unitKey, ETechTrait trait) const
+{
+	const FModifier* modifier = Modifiers.Find({ unitKey, trait });
+	return modifier ? modifier->Value : 0.f;
+}
+
+int32 FMineTechCache::GetCount(FName unitKey, ETechTrait trait) const
+{
+	const FModifier* modifier = Modifiers.Find({ unitKey, trait });
+	return modifier ? modifier->Count : 0;
+}
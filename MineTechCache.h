@@ -0,0 +1,49 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "MineEnums.h"
+
+class UTechNode;
+
+
+// Active tech totals per unit key and trait, so unit logic doesn't scan ActiveTech
+struct FMineTechCache
+{
+	// Rebuild if the tech list changed since the last sync, or is another session's list
+	void Sync(const TArray<UTechNode*>& activeTech);
+	void Invalidate() { bDirty = true; }
+
+	// Sum of TraitValue for matching tech
+	float GetValue(FName unitKey, ETechTrait trait) const;
+
+	// Number of matching tech
+	int32 GetCount(FName unitKey, ETechTrait trait) const;
+
+	bool Has(FName unitKey, ETechTrait trait) const { return GetCount(unitKey, trait) > 0; }
+
+	// Bumped on every rebuild, units can compare against it to refresh their own copies
+	uint32 GetVersion() const { return Version; }
+
+private:
+	struct FKey
+	{
+		FName UnitKey;
+		ETechTrait Trait;
+
+		bool operator==(const FKey& other) const { return UnitKey == other.UnitKey && Trait == other.Trait; }
+		friend uint32 GetTypeHash(const FKey& key) { return HashCombine(GetTypeHash(key.UnitKey), static_cast<uint32>(key.Trait)); }
+	};
+
+	struct FModifier
+	{
+		float Value = 0.f;
+		int32 Count = 0;
+	};
+
+	TMap<FKey, FModifier> Modifiers;
+	const TArray<UTechNode*>* Source = nullptr;
+	int32 TechNum = INDEX_NONE;
+	uint32 Version = 0;
+	bool bDirty = true;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+// Fixed-capacity FIFO of cell indices. Storage is kept between searches.
+struct FMineCellQueue
+{
+	void Reset(int32 capacity)
+	{
+		if(Items.Num() < capacity)
+			Items.SetNumUninitialized(capacity);
+
+		Capacity = capacity;
+		Head = 0;
+		Count = 0;
+	}
+
+	void Push(int32 cell)
+	{
+		check(Count < Capacity);
+		int32 tail = Head + Count;
+		Items[tail < Capacity ? tail : tail - Capacity] = cell;
+		Count++;
+	}
+
+	int32 Pop()
+	{
+		check(Count > 0);
+		int32 cell = Items[Head];
+		Head = Head + 1 == Capacity ? 0 : Head + 1;
+		Count--;
+		return cell;
+	}
+
+	bool IsEmpty() const { return Count == 0; }
+
+	TArray<int32> Items;
+	int32 Capacity = 0;
+	int32 Head = 0;
+	int32 Count = 0;
+};
+
+
+// Per-grid visited set. Clear() bumps a generation counter instead of touching every cell.
+struct FMineVisitedSet
+{
+	void Init(int32 num)
+	{
+		if(Stamps.Num() != num)
+		{
+			Stamps.Init(0, num);
+			Generation = 0;
+		}
+		Clear();
+	}
+
+	void Clear()
+	{
+		if(++Generation == 0)
+		{
+			// wrapped, stale stamps could match again
+			FMemory::Memzero(Stamps.GetData(), Stamps.Num() * sizeof(uint32));
+			Generation = 1;
+		}
+	}
+
+	bool Contains(int32 cell) const { return Stamps[cell] == Generation; }
+
+	// Returns false if the cell was already visited
+	bool Add(int32 cell)
+	{
+		if(Stamps[cell] == Generation) return false;
+		Stamps[cell] = Generation;
+		return true;
+	}
+
+	TArray<uint32> Stamps;
+	uint32 Generation = 0;
+};
+
+
+// Breadth first search scratch shared by all path queries on a grid.
+// Cells are marked when queued so each cell enters the queue at most once.
+struct FMineTraversal
+{
+	// Start a new search over a grid of numCells
+	void Begin(int32 numCells)
+	{
+		Visited.Init(numCells);
+		Queue.Reset(numCells);
+	}
+
+	// Start another search on the same visited set, e.g. the next component
+	void Continue()
+	{
+		Queue.Reset(Queue.Capacity);
+	}
+
+	bool Visit(int32 cell)
+	{
+		if(!Visited.Add(cell)) return false;
+		Queue.Push(cell);
+		return true;
+	}
+
+	bool HasNext() const { return !Queue.IsEmpty(); }
+	int32 Next() { return Queue.Pop(); }
+
+	FMineCellQueue Queue;
+	FMineVisitedSet Visited;
+};
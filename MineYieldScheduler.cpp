@@ -0,0 +1,84 @@
+#include "MineYieldScheduler.h"
+#include "ConverterUnitActor.h"
+#include "MineshaftGameInstance.h"
+
+
+void FMineYieldScheduler::Register(AGridUnitActor* unit)
+{
+	Units.AddUnique(unit);
+
+	if(AConverterUnitActor* converter = Cast<AConverterUnitActor>(unit))
+		Converters.AddUnique(converter);
+}
+
+void FMineYieldScheduler::Unregister(AGridUnitActor* unit)
+{
+	Units.RemoveSingle(unit);
+
+	if(AConverterUnitActor* converter = Cast<AConverterUnitActor>(unit))
+		Converters.RemoveSingle(converter);
+}
+
+const TArray<AGridUnitActor*>& FMineYieldScheduler::GetUnits()
+{
+	Snapshot();
+	return UnitSnapshot;
+}
+
+const TArray<AConverterUnitActor*>& FMineYieldScheduler::GetConverters()
+{
+	Snapshot();
+	return ConverterSnapshot;
+}
+
+void FMineYieldScheduler::Snapshot()
+{
+	Units.RemoveAll([](const TWeakObjectPtr<AGridUnitActor>& unit) { return !unit.IsValid(); });
+	Converters.RemoveAll([](const TWeakObjectPtr<AConverterUnitActor>& converter) { return !converter.IsValid(); });
+
+	UnitSnapshot.Reset();
+	for(const TWeakObjectPtr<AGridUnitActor>& unit : Units)
+		UnitSnapshot.Add(unit.Get());
+
+	ConverterSnapshot.Reset();
+	for(const TWeakObjectPtr<AConverterUnitActor>& converter : Converters)
+		ConverterSnapshot.Add(converter.Get());
+}
+
+FCurrencyVector FMineYieldScheduler::Tick(USessionManager* sm)
+{
+	Snapshot();
+
+	// Units see the wallet as it was at the start of the tick. Converters share it through one set of ratios.
+	if(ConverterSnapshot.Num() > 0)
+		Solver.Solve(ConverterSnapshot, FCurrencyVector::FromMap(sm->Wallet.Amounts));
+
+	// Gather
+	Batch.SetNumUninitialized(UnitSnapshot.Num(), false);
+	for(int32 idx = 0; idx < UnitSnapshot.Num(); ++idx)
+	{
+		Batch[idx].Reset();
+		if(AConverterUnitActor* converter = Cast<AConverterUnitActor>(UnitSnapshot[idx]))
+			converter->GetTotalYieldAtRatios(Batch[idx], Solver.GetRatios());
+		else
+			UnitSnapshot[idx]->SumYieldAmount(Batch[idx]);
+	}
+
+	// Sum in one pass over contiguous vectors
+	FCurrencyVector total;
+	for(const FCurrencyVector& amounts : Batch)
+		total += amounts;
+
+	AGridUnitActor::AddToWallet(sm, total);
+
+	// YieldTickBP can spawn or destroy units, which registers into Units. Notify from a copy of the snapshot
+	// and skip anything destroyed earlier in the loop.
+	TArray<AGridUnitActor*> notify = UnitSnapshot;
+	for(AGridUnitActor* unit : notify)
+	{
+		if(IsValid(unit))
+			unit->OnYieldTick();
+	}
+
+	return total;
+}
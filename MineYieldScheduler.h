@@ -0,0 +1,42 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "MineConversionSolver.h"
+#include "MineCurrency.h"
+
+class AConverterUnitActor;
+class AGridUnitActor;
+class USessionManager;
+
+
+// Session-wide day tick. Sums every registered unit's yield into one batch, pays the wallet once,
+// then calls OnYieldTick on each unit. Same payout and notify as calling DoYield unit by unit.
+struct FMineYieldScheduler
+{
+	void Register(AGridUnitActor* unit);
+	void Unregister(AGridUnitActor* unit);
+
+	// Returns the total paid into the wallet
+	FCurrencyVector Tick(USessionManager* sm);
+
+	// Snapshot of the live units. Registering or unregistering while iterating it is safe.
+	const TArray<AGridUnitActor*>& GetUnits();
+	const TArray<AConverterUnitActor*>& GetConverters();
+
+private:
+	// Drops units that were destroyed without unregistering and refreshes the snapshots
+	void Snapshot();
+
+	TArray<TWeakObjectPtr<AGridUnitActor>> Units;
+
+	// Also in Units. Their inputs are shared out by Solver before any yield is gathered.
+	TArray<TWeakObjectPtr<AConverterUnitActor>> Converters;
+	FMineConversionSolver Solver;
+
+	TArray<AGridUnitActor*> UnitSnapshot;
+	TArray<AConverterUnitActor*> ConverterSnapshot;
+
+	// One yield vector per unit, kept between ticks
+	TArray<FCurrencyVector> Batch;
+};
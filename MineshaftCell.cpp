@@ -0,0 +1,72 @@
+#include "MineshaftCell.h"
+#include "MineGridUnit.h"
+
+
+void UMineshaftCell::Bind(AMineGridUnit* unit, int32 index)
+{
+	Unit = unit;
+	Index = index;
+	Row = unit->CellStore.RowOf(index);
+	Col = unit->CellStore.ColOf(index);
+}
+
+ECurrency UMineshaftCell::GetCurrency() const
+{
+	return Unit->CellStore.Currency[Index];
+}
+
+float UMineshaftCell::GetBank() const
+{
+	return Unit->CellStore.Bank[Index];
+}
+
+float UMineshaftCell::GetBankMax() const
+{
+	return Unit->CellStore.BankMax[Index];
+}
+
+EMineCellTrack UMineshaftCell::GetTrackType() const
+{
+	return Unit->CellStore.GetTrackType(Index);
+}
+
+int32 UMineshaftCell::GetWallVariant() const
+{
+	return Unit->CellStore.WallVariant[Index];
+}
+
+int32 UMineshaftCell::GetWallOrientation() const
+{
+	return Unit->CellStore.WallOrientation[Index];
+}
+
+ECellOrientation UMineshaftCell::GetOrientation() const
+{
+	return Unit->CellStore.Orientation[Index];
+}
+
+bool UMineshaftCell::IsRepo() const
+{
+	return Unit->CellStore.IsRepo(Index);
+}
+
+bool UMineshaftCell::IsProducer() const
+{
+	return Unit->CellStore.IsProducer(Index);
+}
+
+bool UMineshaftCell::IsInProductiveChain() const
+{
+	return Unit->CellStore.HasFlag(Index, EMineCellFlags::InProductiveChain);
+}
+
+float UMineshaftCell::GetCurrentYield() const
+{
+	return Unit->CellStore.CurrentYield[Index];
+}
+
+TArray<FProductionChain> UMineshaftCell::GetProductionChains() const
+{
+	TArrayView<const FProductionChain> chains = Unit->CellStore.GetChains(Index);
+	return TArray<FProductionChain>(chains.GetData(), chains.Num());
+}
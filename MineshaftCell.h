@@ -8,6 +8,8 @@
 
 #include "MineshaftCell.generated.h"
 
+class AMineGridUnit;
+
 USTRUCT(BlueprintType)
 struct FProductionChain
 {
@@ -21,68 +23,48 @@ struct FProductionChain
 
 	UPROPERTY(BlueprintReadOnly) 
 	ECurrency Currency = ECurrency::Stone;
+
+	// Producers flowing through this cell with the same origin, exit and currency
+	UPROPERTY(BlueprintReadOnly) 
+	int32 Count = 1;
+
+	bool operator==(const FProductionChain& other) const
+	{
+		return Origin == other.Origin && Exit == other.Exit && Currency == other.Currency && Count == other.Count;
+	}
 };
 
 
+// Blueprint-facing view of a single cell. Cell data lives in the owning unit's FMineCellStore.
 UCLASS()
 class MINESHAFT3_API UMineshaftCell : public UObject
 {
 	GENERATED_BODY()
 
 public:
+	void Bind(AMineGridUnit* unit, int32 index);
+
+	// Shown under the names of the per-cell properties they replaced
+
+	UFUNCTION(BlueprintPure, meta=(DisplayName="Currency")) ECurrency GetCurrency() const;
+	UFUNCTION(BlueprintPure, meta=(DisplayName="Bank")) float GetBank() const;
+	UFUNCTION(BlueprintPure, meta=(DisplayName="BankMax")) float GetBankMax() const;
+	UFUNCTION(BlueprintPure, meta=(DisplayName="TrackType")) EMineCellTrack GetTrackType() const;
+	UFUNCTION(BlueprintPure, meta=(DisplayName="WallVariant")) int32 GetWallVariant() const;
+	UFUNCTION(BlueprintPure, meta=(DisplayName="WallOrientation")) int32 GetWallOrientation() const;
+	UFUNCTION(BlueprintPure, meta=(DisplayName="Orientation")) ECellOrientation GetOrientation() const;
+	UFUNCTION(BlueprintPure, meta=(DisplayName="Repo")) bool IsRepo() const;
+	UFUNCTION(BlueprintPure, meta=(DisplayName="Producer")) bool IsProducer() const;
+	UFUNCTION(BlueprintPure, meta=(DisplayName="InProductiveChain")) bool IsInProductiveChain() const;
+	UFUNCTION(BlueprintPure, meta=(DisplayName="CurrentYield")) float GetCurrentYield() const;
+	UFUNCTION(BlueprintPure, meta=(DisplayName="ProductionChains")) TArray<FProductionChain> GetProductionChains() const;
 
 	UPROPERTY(BlueprintReadOnly) int32 Row = 0;
 	UPROPERTY(BlueprintReadOnly) int32 Col = 0;
-	
-	UPROPERTY(BlueprintReadOnly) ECurrency Currency = ECurrency::Stone;
-	UPROPERTY(BlueprintReadOnly) float Bank = 0.f;
-	UPROPERTY(BlueprintReadOnly) float BankMax = 0.f;
-	
-	UPROPERTY(BlueprintReadOnly) EMineCellTrack TrackType = EMineCellTrack::None;
-	UPROPERTY(BlueprintReadOnly) int32 WallVariant = 0; //0-15, initial assignment 
-	UPROPERTY(BlueprintReadOnly) int32 WallOrientation = 0; //0-15
-	UPROPERTY(BlueprintReadOnly) ECellOrientation Orientation = ECellOrientation::North;
-
-	UPROPERTY(BlueprintReadOnly) bool Repo = false;
-	UPROPERTY(BlueprintReadOnly) bool Producer = false;
-	
-	UPROPERTY(BlueprintReadOnly) bool InProductiveChain = false; 
-	UPROPERTY(BlueprintReadOnly) float CurrentYield = 0.f;
-	UPROPERTY(BlueprintReadOnly) TArray<FProductionChain> ProductionChains;  
 
-	TSet<UMineshaftCell*> Links;
-	TMap<ECellOrientation, UMineshaftCell*> Neighbors;
-	
-	TMap<ECellOrientation, UMineshaftCell*> YieldLinks; 
-	int32 DistanceToExit = 0;
+	int32 Index = INDEX_NONE;
 
-	inline static TMap<int32, EMineCellTrack> S_TrackTypes =
-	{
-		{ 0, 	EMineCellTrack::None },
-		{ 1, 	EMineCellTrack::None },
-		{ 2, 	EMineCellTrack::None },
-		{ 3, 	EMineCellTrack::Curve },
-		{ 4, 	EMineCellTrack::None },
-		{ 5, 	EMineCellTrack::Straight },
-		{ 6, 	EMineCellTrack::Curve },
-		{ 7, 	EMineCellTrack::T },
-		{ 8, 	EMineCellTrack::None },
-		{ 9, 	EMineCellTrack::Curve },
-		{ 10, 	EMineCellTrack::Straight },
-		{ 11, 	EMineCellTrack::T },
-		{ 12, 	EMineCellTrack::Curve },
-		{ 13, 	EMineCellTrack::T },
-		{ 14, 	EMineCellTrack::T },
-		{ 15, 	EMineCellTrack::Cross },
-	};
-
-	inline static TMap<EMineCellTrack, int32> S_WallVariants =
-	{
-		{ EMineCellTrack::None,		0 },
-		{ EMineCellTrack::Curve,	3 },
-		{ EMineCellTrack::Straight, 5 },
-		{ EMineCellTrack::T,		7 },
-		{ EMineCellTrack::Cross,	15 },
-	};
+	UPROPERTY() 
+	AMineGridUnit* Unit = nullptr;
 	
 };
\ No newline at end of file
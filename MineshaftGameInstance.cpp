@@ -1,11 +1,15 @@
 
 #include "MineshaftGameInstance.h"
+#include "ConverterUnitActor.h"
+#include "MineGridUnit.h"
 #include "Kismet/GameplayStatics.h"
 
 
 
 void UMineshaftGameInstance::Setup()
 {
+	checkf(StaticEnum<ECurrency>()->GetMaxEnumValue() <= MineCurrencyLanes, TEXT("ECurrency outgrew MineCurrencyLanes"));
+
 	SetupSaveGames();
 	LoadSaveGames();
 }
@@ -57,6 +61,10 @@ void UMineshaftGameInstance::LoadSaveGame(ESaveGameType savetype)
 			
 			if(UMineSaveGame* mineSavegame = Cast<UMineSaveGame>(savegame))
 				mineSavegame->Load(this, m_savegames[savetype]);
+
+			// The loaded ActiveTech can match the old one in count
+			if(savetype == ESaveGameType::Session)
+				InvalidateTechCache();
 			
 			m_savegames[savetype].Loaded = true;
 			ValidateLoadComplete();
@@ -74,6 +82,10 @@ void UMineshaftGameInstance::LoadSaveGames()
 
 void UMineshaftGameInstance::LoadSession()
 {
+	m_patternTable.Reset();
+	m_buffInfluence.Reset();
+	m_intentOverlay.Reset(SessionManager);
+	InvalidateTechCache();
 	LoadSaveGame(ESaveGameType::Session);
 }
 
@@ -84,6 +96,136 @@ void UMineshaftGameInstance::DeleteSave(ESaveGameType savetype)
 		savegame->Delete(m_savegames[savetype]);
 }
 
+// Tech added mid session is picked up here, so every rebuild has to reach the yield widgets
+const FMineTechCache& UMineshaftGameInstance::GetTechCache()
+{
+	uint32 version = m_techCache.GetVersion();
+	m_techCache.Sync(SessionManager->ActiveTech);
+	if(m_techCache.GetVersion() != version)
+		InvalidateMineYields();
+
+	return m_techCache;
+}
+
+void UMineshaftGameInstance::InvalidateTechCache()
+{
+	m_techCache.Invalidate();
+
+	// Rebuild now rather than on the next read, so bound widgets hear about it
+	if(SessionManager)
+		GetTechCache();
+}
+
+// Mines cache tech scaled yield, let their widgets know
+void UMineshaftGameInstance::InvalidateMineYields()
+{
+	for(AGridUnitActor* unit : m_yieldScheduler.GetUnits())
+	{
+		if(AMineGridUnit* mine = Cast<AMineGridUnit>(unit))
+			mine->InvalidateYield();
+	}
+}
+
+void UMineshaftGameInstance::DoYieldTick()
+{
+	m_yieldScheduler.Tick(SessionManager);
+}
+
+void UMineshaftGameInstance::SetAttackIntent(const AGridUnitActor* unit, TArrayView<const FCoordinates> coords)
+{
+	m_intentOverlay.Set(unit, coords);
+	ScheduleIntentFlush();
+}
+
+void UMineshaftGameInstance::ClearAttackIntent(const AGridUnitActor* unit)
+{
+	m_intentOverlay.Remove(unit);
+	ScheduleIntentFlush();
+}
+
+// Any number of intent changes in a frame become one push
+void UMineshaftGameInstance::ScheduleIntentFlush()
+{
+	if(m_intentFlushPending || !m_intentOverlay.IsDirty()) return;
+
+	m_intentFlushPending = true;
+	GetTimerManager().SetTimerForNextTick(this, &UMineshaftGameInstance::FlushIntents);
+}
+
+void UMineshaftGameInstance::FlushIntents()
+{
+	m_intentFlushPending = false;
+	if(SessionManager)
+		m_intentOverlay.Flush(SessionManager);
+}
+
+// Mines pay a constant yield between depletion events. Step the whole session event to event so
+// converters see a constant income per span and can use their closed form.
+void UMineshaftGameInstance::FastForwardYield(int32 days)
+{
+	const TArray<AConverterUnitActor*>& converters = m_yieldScheduler.GetConverters();
+	TArray<AMineGridUnit*> mines;
+
+	// Other units have no banks to drain, their yield holds for the whole fast forward
+	FCurrencyVector otherPerTick;
+	for(AGridUnitActor* unit : m_yieldScheduler.GetUnits())
+	{
+		if(unit->IsA<AConverterUnitActor>()) continue;
+
+		if(AMineGridUnit* mine = Cast<AMineGridUnit>(unit))
+			mines.Add(mine);
+		else
+			unit->SumYieldAmount(otherPerTick);
+	}
+
+	FCurrencyVector wallet = FCurrencyVector::FromMap(SessionManager->Wallet.Amounts);
+	FCurrencyVector total;
+	while(days > 0)
+	{
+		int32 span = days;
+		for(AMineGridUnit* mine : mines)
+			span = FMath::Min(span, mine->GetTicksToNextYieldChange());
+
+		FCurrencyVector income;
+		for(AMineGridUnit* mine : mines)
+			income += mine->FastForward(span);
+
+		FCurrencyVector other = otherPerTick;
+		other.Scale(static_cast<float>(span));
+		income += other;
+
+		FCurrencyVector incomePerTick = income;
+		incomePerTick.Scale(1.f / span);
+
+		// All converters share their inputs through one set of ratios per span
+		FCurrencyVector demand;
+		for(AConverterUnitActor* converter : converters)
+			converter->AddInputDemand(demand);
+
+		FCurrencyVector converted;
+		FMineConversionSolver::ForEachSpan(span, demand, wallet, incomePerTick, [&](const FCurrencyVector& ratios, int32 spanTicks)
+		{
+			// Each converter applies its own buffs and tech, keep their totals apart until scaled
+			for(AConverterUnitActor* converter : converters)
+			{
+				FCurrencyVector amounts;
+				converter->GetTotalYieldAtRatios(amounts, ratios);
+				amounts.Scale(static_cast<float>(spanTicks));
+				converted += amounts;
+			}
+		});
+
+		wallet += converted;
+		total += converted;
+
+		wallet += income;
+		total += income;
+		days -= span;
+	}
+
+	AGridUnitActor::AddToWallet(SessionManager, total);
+}
+
 void UMineshaftGameInstance::ValidateLoadComplete()
 {
 	bool bComplete = true;
@@ -4,6 +4,11 @@
 #include "CoreMinimal.h"
 #include "Engine/GameInstance.h"
 
+#include "MineBuffInfluence.h"
+#include "MineIntentOverlay.h"
+#include "MinePatternTable.h"
+#include "MineTechCache.h"
+#include "MineYieldScheduler.h"
 #include "RulesConfig.h"
 #include "SessionManager.h"
 #include "SettingsSaveGame.h"
@@ -45,6 +50,35 @@ public:
 	
 	UFUNCTION(BlueprintCallable) 
 	void DeleteSave(ESaveGameType savetype);
+
+	// Tech trait totals for the session, rebuilt when ActiveTech changes
+	const FMineTechCache& GetTechCache();
+	void InvalidateTechCache();
+
+	// Pay out one day of yield for every grid unit in a single batch
+	UFUNCTION(BlueprintCallable) 
+	void DoYieldTick();
+
+	// Offline progress for a restored session. Pays out N days of yield with one wallet update, no YieldTickBP.
+	UFUNCTION(BlueprintCallable) 
+	void FastForwardYield(int32 days);
+
+	FMineYieldScheduler& GetYieldScheduler() { return m_yieldScheduler; }
+
+	// Buff and attack coordinates per template and origin cell, reset with the session
+	FMinePatternTable& GetPatternTable() { return m_patternTable; }
+
+	// Buffs reaching each grid cell, updated as buffing units place, move and clear
+	FMineBuffInfluence& GetBuffInfluence() { return m_buffInfluence; }
+
+	// Attack intent counts per grid cell. Changes are pushed to the cell actors once, on the next tick.
+	void SetAttackIntent(const AGridUnitActor* unit, TArrayView<const FCoordinates> coords);
+	void ClearAttackIntent(const AGridUnitActor* unit);
+
+	UFUNCTION(BlueprintCallable) 
+	void FlushIntents();
+
+	const FMineIntentOverlay& GetIntentOverlay() const { return m_intentOverlay; }
 	
 	UPROPERTY(BlueprintReadOnly) 
 	FAppSettings AppSettings;
@@ -57,4 +91,13 @@ public:
 	
 private:
 	TMap<ESaveGameType, FSaveGameInfo> m_savegames;
+	FMineTechCache m_techCache;
+	FMineYieldScheduler m_yieldScheduler;
+	FMinePatternTable m_patternTable;
+	FMineBuffInfluence m_buffInfluence;
+	FMineIntentOverlay m_intentOverlay;
+	bool m_intentFlushPending = false;
+
+	void ScheduleIntentFlush();
+	void InvalidateMineYields();
 };